@@ -0,0 +1,47 @@
+#!/bin/bash
+# Benchmark of --ast-cache.
+#
+# Generates synthetic Mini-C programs with gen_minic and times the front end
+# (--check: lexing, parsing, semantic analysis and constant folding) of each
+# without the AST cache, when it is stored (a miss) and when it is loaded (a
+# hit). The size of the cache file and the speedup of a hit are printed and
+# written to a CSV file.
+#
+# Environment:
+#   SIZES     space separated target sizes (default "1M 10M")
+#   REPEAT    timed runs per size and mode, the fastest is reported (default 3)
+#   SEED      generator seed (default 1)
+#   GENFLAGS  extra gen_minic knobs, e.g. "--functions 5000"
+#   MCFLAGS   extra mccomp flags for every mode, e.g. "-O2" without --check
+#             to time whole compiles (default "--check")
+#   OUT       result CSV (default bench/ast_cache_results.csv)
+#   WORKDIR   where generated programs are kept (default: a temporary directory)
+
+source "$(dirname "$0")/common.sh"
+SIZES=${SIZES:-"1M 10M"}
+MCFLAGS=${MCFLAGS:---check}
+OUT=${OUT:-$BENCH/ast_cache_results.csv}
+
+echo "size,source_bytes,cache_bytes,parse_seconds,store_seconds,load_seconds,speedup" > "$OUT"
+printf "%-6s %12s %12s %10s %10s %10s %8s\n" size source cache parse store load speedup
+for size in $SIZES; do
+  src="$WORKDIR/bench_$size.c"
+  gen_program "$src" --size "$size"
+  rm -f "$src.astcache"
+
+  # with CLEAR every run of the store is a miss
+  parse=$(best_time "$COMP" -fno-print-ast $MCFLAGS "$src")
+  store=$(CLEAR="$src.astcache" best_time "$COMP" -fno-print-ast $MCFLAGS --ast-cache "$src")
+  load=$(best_time "$COMP" -fno-print-ast $MCFLAGS --ast-cache "$src")
+  if [ "$parse" == failed ] || [ "$store" == failed ] || [ "$load" == failed ] || [ ! -f "$src.astcache" ]; then
+    printf "%-6s %12s\n" $size failed
+    echo "$size,,,,,," >> "$OUT"
+    continue
+  fi
+  bytes=$(wc -c < "$src")
+  cache=$(wc -c < "$src.astcache")
+  awk -v size=$size -v bytes=$bytes -v cache=$cache -v parse=$parse -v store=$store -v load=$load -v out="$OUT" 'BEGIN {
+    printf "%s,%d,%d,%.4f,%.4f,%.4f,%.2f\n", size, bytes, cache, parse / 1e9, store / 1e9, load / 1e9, parse / load >> out
+    printf "%-6s %12d %12d %10.4f %10.4f %10.4f %7.2fx\n", size, bytes, cache, parse / 1e9, store / 1e9, load / 1e9, parse / load
+  }'
+done
@@ -0,0 +1,64 @@
+#!/bin/bash
+# Compile-time benchmark for mccomp.
+#
+# Generates synthetic Mini-C programs of increasing size with gen_minic, times
+# mccomp on each and writes throughput (lines/s, tokens/s) and peak memory to a
+# CSV file. If a baseline CSV exists the run is compared against it.
+#
+# Environment:
+#   SIZES     space separated target sizes (default "1K 10K 100K 1M 10M 100M")
+#   REPEAT    timed runs per size, the fastest is reported (default 3)
+#   SEED      generator seed (default 1)
+#   GENFLAGS  extra gen_minic knobs, e.g. "--depth 6 --expr-len 12"
+#   MCFLAGS   extra mccomp flags, e.g. "-O2"
+#   OUT       result CSV (default bench/compile_results.csv)
+#   BASELINE  baseline CSV to compare with (default bench/compile_baseline.csv)
+#   WORKDIR   where generated programs are kept (default: a temporary directory)
+
+source "$(dirname "$0")/common.sh"
+SIZES=${SIZES:-"1K 10K 100K 1M 10M 100M"}
+OUT=${OUT:-$BENCH/compile_results.csv}
+BASELINE=${BASELINE:-$BENCH/compile_baseline.csv}
+
+echo "size,bytes,lines,tokens,seconds,lines_per_sec,tokens_per_sec,peak_rss_kb,status" > "$OUT"
+
+for size in $SIZES; do
+  src="$WORKDIR/bench_$size.c"
+  gen_program "$src" --size "$size"
+  bytes=$(wc -c < "$src")
+  lines=$(wc -l < "$src")
+
+  # timed runs without statistics collection, keeping the fastest
+  best=$(best_time "$COMP" $MCFLAGS "$src")
+  status=$([ "$best" == failed ] && echo failed || echo ok)
+
+  # one untimed run for the token count and peak memory
+  tokens=0
+  rss=0
+  if [ $status == ok ]; then
+    (cd "$WORKDIR" && "$COMP" $MCFLAGS --stats-json="$WORKDIR/stats.json" "$src" > /dev/null 2>&1)
+    tokens=$(sed -n 's/^  "tokens": \([0-9]*\),/\1/p' "$WORKDIR/stats.json")
+    rss=$(sed -n 's/^  "peakRSSKB": \([0-9]*\),\{0,1\}$/\1/p' "$WORKDIR/stats.json")
+  fi
+
+  awk -v size=$size -v bytes=$bytes -v lines=$lines -v tokens=$tokens -v ns=$best \
+      -v rss=$rss -v status=$status 'BEGIN {
+    s = ns / 1e9
+    if (status != "ok")
+      printf "%s,%d,%d,0,0,0,0,0,%s\n", size, bytes, lines, status
+    else
+      printf "%s,%d,%d,%d,%.4f,%.0f,%.0f,%d,%s\n", size, bytes, lines, tokens, s,
+             lines / s, tokens / s, rss, status
+  }' >> "$OUT"
+  tail -1 "$OUT"
+done
+
+# compare against the baseline: ratio > 1 means slower / more memory than it
+if [ -f "$BASELINE" ] && [ "$BASELINE" != "$OUT" ]; then
+  echo
+  echo "Compared with $BASELINE:"
+  awk -F, 'NR == FNR { if (FNR > 1) { t[$1] = $5; m[$1] = $8 } next }
+    FNR > 1 && ($1 in t) && $9 == "ok" && t[$1] > 0 && m[$1] > 0 {
+      printf "  %-6s time x%.2f  peak RSS x%.2f\n", $1, $5 / t[$1], $8 / m[$1]
+    }' "$BASELINE" "$OUT"
+fi
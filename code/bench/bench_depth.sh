@@ -0,0 +1,68 @@
+#!/bin/bash
+# Benchmark of mccomp on pathologically deep nesting.
+#
+# Generates one Mini-C program per nesting pattern and depth and times a full
+# compile of each with -fno-print-ast (the AST printout indents every node by
+# its depth, so it grows with the square of the depth). The patterns are
+# nested parentheses, a chain of unary minus, a long left-associative chain of
+# additions, nested if statements and nested while loops. A compile that
+# crashes, e.g. on a stack overflow, is reported as failed with its exit
+# status. The results are printed and written to a CSV file.
+#
+# Environment:
+#   DEPTHS    space separated nesting depths (default "1000 10000 100000")
+#   PATTERNS  patterns to run (default "parens unary chain if while")
+#   MCFLAGS   extra mccomp flags, e.g. "-O2"
+#   OUT       result CSV (default bench/depth_results.csv)
+#   WORKDIR   where generated programs are kept (default: a temporary directory)
+
+source "$(dirname "$0")/common.sh"
+DEPTHS=${DEPTHS:-"1000 10000 100000"}
+PATTERNS=${PATTERNS:-"parens unary chain if while"}
+OUT=${OUT:-$BENCH/depth_results.csv}
+
+# generate <pattern> <depth>: a program whose single function nests <depth> deep
+function generate {
+  awk -v pattern=$1 -v depth=$2 'BEGIN {
+    print "int f(int a) {"
+    if (pattern == "parens") {
+      printf "  return "
+      for (i = 0; i < depth; i++) printf "(a + "
+      printf "a"
+      for (i = 0; i < depth; i++) printf ")"
+      print ";"
+    } else if (pattern == "unary") {
+      printf "  return "
+      for (i = 0; i < depth; i++) printf "- "
+      print "a;"
+    } else if (pattern == "chain") {
+      printf "  return a"
+      for (i = 0; i < depth; i++) printf " + a"
+      print ";"
+    } else if (pattern == "if" || pattern == "while") {
+      for (i = 0; i < depth; i++) printf "%s (a > %d) {\n", pattern, i
+      print "a = a - 1;"
+      for (i = 0; i < depth; i++) printf "}\n"
+      print "  return a;"
+    }
+    print "}"
+  }'
+}
+
+echo "pattern,depth,status,seconds" > "$OUT"
+printf "%-8s %8s %8s %10s\n" pattern depth status seconds
+for pattern in $PATTERNS; do
+  for depth in $DEPTHS; do
+    src="$WORKDIR/${pattern}_$depth.c"
+    generate $pattern $depth > "$src"
+    start=$(date +%s%N)
+    (cd "$WORKDIR" && "$COMP" -fno-print-ast $MCFLAGS "$src" > /dev/null 2>&1)
+    status=$?
+    end=$(date +%s%N)
+    result=$([ $status == 0 ] && echo ok || echo "failed($status)")
+    awk -v p=$pattern -v d=$depth -v r=$result -v ns=$((end - start)) -v out="$OUT" 'BEGIN {
+      printf "%s,%s,%s,%.4f\n", p, d, r, ns / 1e9 >> out
+      printf "%-8s %8s %8s %10.4f\n", p, d, r, ns / 1e9
+    }'
+  done
+done
@@ -0,0 +1,45 @@
+#!/bin/bash
+# Benchmark of --lazy-bodies against full compilation.
+#
+# Generates synthetic Mini-C programs with gen_minic and times a full compile
+# of each with and without --lazy-bodies, whose roots are the last function
+# of the program unless ROOTS is set. The functions it calls, directly or not,
+# are generated; the bodies of the others are only skimmed. The number of
+# function bodies parsed, from --stats, and the speedup are printed and
+# written to a CSV file.
+#
+# Environment:
+#   SIZES     space separated target sizes (default "1M 10M")
+#   REPEAT    timed runs per size and mode, the fastest is reported (default 3)
+#   SEED      generator seed (default 1)
+#   GENFLAGS  extra gen_minic knobs, e.g. "--functions 5000"
+#   ROOTS     comma separated --lazy-bodies roots (default: the last function)
+#   MCFLAGS   extra mccomp flags for both modes, e.g. "-O2"
+#   OUT       result CSV (default bench/lazy_results.csv)
+#   WORKDIR   where generated programs are kept (default: a temporary directory)
+
+source "$(dirname "$0")/common.sh"
+SIZES=${SIZES:-"1M 10M"}
+OUT=${OUT:-$BENCH/lazy_results.csv}
+
+echo "size,functions,parsed,full_seconds,lazy_seconds,speedup" > "$OUT"
+printf "%-6s %10s %8s %10s %10s %8s\n" size functions parsed full lazy speedup
+for size in $SIZES; do
+  src="$WORKDIR/bench_$size.c"
+  gen_program "$src" --size "$size"
+  roots=${ROOTS:-$(grep -oE '^(int|float|bool|void) [A-Za-z_0-9]+\(' "$src" | tail -1 | sed -E 's/^[a-z]+ //; s/\($//')}
+  functions=$(grep -cE '^(int|float|bool|void) [A-Za-z_0-9]+\(' "$src")
+  parsed=$(cd "$WORKDIR" && "$COMP" -fno-print-ast --stats --lazy-bodies="$roots" "$src" 2>&1 | awk '/Function bodies parsed/ { print $1 }')
+
+  full=$(best_time "$COMP" -fno-print-ast $MCFLAGS "$src")
+  lazy=$(best_time "$COMP" -fno-print-ast $MCFLAGS --lazy-bodies="$roots" "$src")
+  if [ "$full" == failed ] || [ "$lazy" == failed ]; then
+    printf "%-6s %10s %8s %10s\n" $size $functions "$parsed" failed
+    echo "$size,$functions,$parsed,,," >> "$OUT"
+    continue
+  fi
+  awk -v size=$size -v functions=$functions -v parsed=$parsed -v full=$full -v lazy=$lazy -v out="$OUT" 'BEGIN {
+    printf "%s,%d,%d,%.4f,%.4f,%.2f\n", size, functions, parsed, full / 1e9, lazy / 1e9, full / lazy >> out
+    printf "%-6s %10d %8d %10.4f %10.4f %7.2fx\n", size, functions, parsed, full / 1e9, lazy / 1e9, full / lazy
+  }'
+done
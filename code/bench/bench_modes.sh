@@ -0,0 +1,47 @@
+#!/bin/bash
+# Benchmark of the checking modes against full compilation.
+#
+# Generates synthetic Mini-C programs with gen_minic and times mccomp on each
+# in three modes: a full compile, --check (lex, parse, semantic analysis and
+# constant folding) and -fsyntax-only (lex and parse). The speedup of each
+# mode over the full compile is printed and written to a CSV file.
+#
+# Environment:
+#   SIZES     space separated target sizes (default "100K 1M 10M")
+#   REPEAT    timed runs per size and mode, the fastest is reported (default 3)
+#   SEED      generator seed (default 1)
+#   GENFLAGS  extra gen_minic knobs, e.g. "--depth 6 --expr-len 12"
+#   MCFLAGS   extra mccomp flags for every mode, e.g. "-O2"
+#   OUT       result CSV (default bench/modes_results.csv)
+#   WORKDIR   where generated programs are kept (default: a temporary directory)
+
+source "$(dirname "$0")/common.sh"
+SIZES=${SIZES:-"100K 1M 10M"}
+OUT=${OUT:-$BENCH/modes_results.csv}
+MODES="full --check -fsyntax-only"
+
+echo "size,mode,seconds,speedup" > "$OUT"
+printf "%-6s %-14s %10s %8s\n" size mode seconds speedup
+for size in $SIZES; do
+  src="$WORKDIR/bench_$size.c"
+  gen_program "$src" --size "$size"
+
+  full=
+  for mode in $MODES; do
+    if [ $mode == full ]; then
+      ns=$(best_time "$COMP" $MCFLAGS "$src")
+      full=$ns
+    else
+      ns=$(best_time "$COMP" $MCFLAGS $mode "$src")
+    fi
+    if [ "$ns" == failed ] || [ "$full" == failed ]; then
+      printf "%-6s %-14s %10s\n" $size $mode failed
+      echo "$size,$mode,," >> "$OUT"
+      continue
+    fi
+    awk -v size=$size -v mode=$mode -v ns=$ns -v full=$full -v out="$OUT" 'BEGIN {
+      printf "%s,%s,%.4f,%.2f\n", size, mode, ns / 1e9, full / ns >> out
+      printf "%-6s %-14s %10.4f %7.2fx\n", size, mode, ns / 1e9, full / ns
+    }'
+  done
+done
@@ -0,0 +1,50 @@
+#!/bin/bash
+# Scaling benchmark of -fparallel-parse.
+#
+# Generates Mini-C programs of thousands of functions with gen_minic and times
+# mccomp -fsyntax-only on each, once parsing serially and once with
+# -fparallel-parse for each thread count, where the function bodies are
+# skimmed and then parsed on the -j threads. Lexing, the skim and the top level
+# stay serial. The speedup over the serial parse is printed and written to a
+# CSV file.
+#
+# Environment:
+#   FUNCTIONS space separated numbers of functions (default "1000 5000 20000")
+#   JOBS      space separated thread counts (default "1 2 4 8")
+#   REPEAT    timed runs per program and thread count, the fastest is reported (default 3)
+#   SEED      generator seed (default 1)
+#   GENFLAGS  gen_minic knobs (default "--stmts 8 --depth 2", about 850 bytes per function)
+#   OUT       result CSV (default bench/parallel_parse_results.csv)
+#   WORKDIR   where generated programs are kept (default: a temporary directory)
+
+source "$(dirname "$0")/common.sh"
+FUNCTIONS=${FUNCTIONS:-"1000 5000 20000"}
+JOBS=${JOBS:-"1 2 4 8"}
+GENFLAGS=${GENFLAGS:-"--stmts 8 --depth 2"}
+OUT=${OUT:-$BENCH/parallel_parse_results.csv}
+
+echo "functions,bytes,jobs,seconds,speedup" > "$OUT"
+printf "%-9s %10s %6s %10s %8s\n" functions bytes jobs seconds speedup
+for functions in $FUNCTIONS; do
+  src="$WORKDIR/bench_$functions.c"
+  gen_program "$src" --functions "$functions"
+  bytes=$(wc -c < "$src")
+
+  serial=$(best_time "$COMP" -fsyntax-only "$src")
+  for jobs in serial $JOBS; do
+    if [ $jobs == serial ]; then
+      ns=$serial
+    else
+      ns=$(best_time "$COMP" -fsyntax-only -fparallel-parse -j $jobs "$src")
+    fi
+    if [ "$ns" == failed ] || [ "$serial" == failed ]; then
+      printf "%-9s %10s %6s %10s\n" $functions $bytes $jobs failed
+      echo "$functions,$bytes,$jobs,," >> "$OUT"
+      continue
+    fi
+    awk -v functions=$functions -v bytes=$bytes -v jobs=$jobs -v ns=$ns -v serial=$serial -v out="$OUT" 'BEGIN {
+      printf "%d,%d,%s,%.4f,%.2f\n", functions, bytes, jobs, ns / 1e9, serial / ns >> out
+      printf "%-9d %10d %6s %10.4f %7.2fx\n", functions, bytes, jobs, ns / 1e9, serial / ns
+    }'
+  done
+done
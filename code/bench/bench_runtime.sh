@@ -0,0 +1,78 @@
+#!/bin/bash
+# Runtime benchmark of mccomp-generated code against clang -O2.
+#
+# Each kernel in bench/runtime is compiled once by mccomp at every optimisation
+# level and once by clang -O2 from the same source, linked with the shared
+# benchmark driver and timed. mccomp's IR is lowered with llc -O2, so the
+# comparison measures mccomp's IR against clang's rather than the backend.
+#
+# Environment:
+#   LEVELS    mccomp optimisation levels (default "O0 O1 O2")
+#   KERNELS   kernels to run (default: all; every kernel is always built)
+#   CLANG     C compiler for the reference build (default clang)
+#   CLANGXX   C++ compiler for the driver (default clang++)
+#   LLC       IR to object compiler (default llc)
+#   OUT       result CSV (default bench/runtime_results.csv)
+#   BENCH_BATCHES, BENCH_MIN_BATCH_MS  passed on to the driver
+#   WORKDIR   where the builds are kept (default: a temporary directory)
+
+source "$(dirname "$0")/common.sh"
+CLANG=${CLANG:-clang}
+CLANGXX=${CLANGXX:-clang++}
+LLC=${LLC:-llc}
+LEVELS=${LEVELS:-"O0 O1 O2"}
+ALL_KERNELS="factorial fibonacci pi cosine palindrome"
+KERNELS=${KERNELS:-$ALL_KERNELS}
+OUT=${OUT:-$BENCH/runtime_results.csv}
+
+# build <config> <compile command for one kernel>; the command is run in the
+# work directory with the kernel name as $1 and must produce $1.o
+function build {
+  local config=$1 objs=
+  shift
+  mkdir -p "$WORKDIR/$config"
+  for k in $ALL_KERNELS; do
+    (cd "$WORKDIR/$config" && "$@" $k) || { echo "$config: failed to compile $k"; exit 1; }
+    objs="$objs $WORKDIR/$config/$k.o"
+  done
+  $CLANGXX -O2 "$BENCH/runtime/driver.cpp" $objs -o "$WORKDIR/bench_$config" || exit 1
+}
+
+function reference {
+  $CLANG -O2 -x c -include stdbool.h -c "$BENCH/runtime/$1.c" -o $1.o
+}
+
+function mccomp {
+  "$COMP" -$LEVEL "$BENCH/runtime/$1.c" > /dev/null 2>&1 &&
+  $LLC -O2 -relocation-model=pic -filetype=obj output.ll -o $1.o
+}
+
+build clang-O2 reference
+for LEVEL in $LEVELS; do
+  build mccomp-$LEVEL mccomp
+done
+
+echo "kernel,config,ns_per_call,slowdown,result,cycles,instructions,branch_misses,l1d_misses" > "$OUT"
+for config in clang-O2 $(for l in $LEVELS; do echo mccomp-$l; done); do
+  "$WORKDIR/bench_$config" $KERNELS 2> "$WORKDIR/counters.log" | tail -n +2 > "$WORKDIR/$config.csv"
+done
+# the driver warns about every hardware counter it cannot open; show it once
+sed 's/^warning: /note: /' "$WORKDIR/counters.log"
+
+# slowdown is relative to clang -O2; results differing by more than 0.1% from
+# clang's are flagged. Counters are per call, "-" when unavailable.
+printf "%-11s %-10s %14s %8s %12s %14s %6s %10s %10s\n" kernel config ns/call slowdown cycles instructions IPC br-misses L1d-misses
+awk -F, -v out="$OUT" '
+  function counter(v) { return v == "" ? "-" : v }
+  FNR == 1 { config = FILENAME; sub(/.*\//, "", config); sub(/\.csv$/, "", config) }
+  config == "clang-O2" { ref[$1] = $2; refResult[$1] = $3 }
+  {
+    slowdown = $2 / ref[$1]
+    diff = $3 - refResult[$1]; if (diff < 0) diff = -diff
+    scale = refResult[$1] < 0 ? -refResult[$1] : refResult[$1]
+    flag = diff > 0.001 * (scale > 1 ? scale : 1) ? "  MISMATCH (result " $3 ", clang " refResult[$1] ")" : ""
+    ipc = $4 != "" && $5 != "" && $4 > 0 ? sprintf("%.2f", $5 / $4) : "-"
+    printf "%s,%s,%s,%.2f,%s,%s,%s,%s,%s\n", $1, config, $2, slowdown, $3, $4, $5, $6, $7 >> out
+    printf "%-11s %-10s %14.1f %7.2fx %12s %14s %6s %10s %10s%s\n", $1, config, $2, slowdown,
+           counter($4), counter($5), ipc, counter($6), counter($7), flag
+  }' "$WORKDIR/clang-O2.csv" $(for l in $LEVELS; do echo "$WORKDIR/mccomp-$l.csv"; done)
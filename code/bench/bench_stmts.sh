@@ -0,0 +1,52 @@
+#!/bin/bash
+# Parser benchmark on statement-dense functions.
+#
+# Generates Mini-C programs with gen_minic whose functions are long lists of
+# short statements, nested in if and while blocks, and times mccomp
+# -fsyntax-only on each, which only lexes and parses. --time-report is not
+# used, as switching between the lexer and parser timers on every token costs
+# more than building the statements. If BASE names another mccomp build, it is
+# timed on the same programs and the speedup over it is reported. The results
+# are printed and written to a CSV file.
+#
+# Environment:
+#   SIZES     space separated target sizes (default "1M 10M")
+#   REPEAT    timed runs per size, the fastest is reported (default 3)
+#   SEED      generator seed (default 1)
+#   GENFLAGS  gen_minic knobs (default "--stmts 40 --depth 4 --expr-len 2 --locals 10")
+#   BASE      mccomp build to compare with (default: none)
+#   OUT       result CSV (default bench/stmts_results.csv)
+#   WORKDIR   where generated programs are kept (default: a temporary directory)
+
+source "$(dirname "$0")/common.sh"
+SIZES=${SIZES:-"1M 10M"}
+GENFLAGS=${GENFLAGS:-"--stmts 40 --depth 4 --expr-len 2 --locals 10"}
+OUT=${OUT:-$BENCH/stmts_results.csv}
+
+# fastest wall time in seconds of REPEAT parses with the given compiler, or "failed"
+function best_parse_time {
+  local ns=$(best_time "$1" -fsyntax-only "$2")
+  [ "$ns" == failed ] && echo failed || awk -v ns=$ns 'BEGIN { printf "%.4f", ns / 1e9 }'
+}
+
+echo "size,statements,parse_seconds,base_parse_seconds,speedup" > "$OUT"
+printf "%-6s %10s %12s %12s %8s\n" size statements parse base speedup
+for size in $SIZES; do
+  src="$WORKDIR/bench_$size.c"
+  gen_program "$src" --size "$size"
+  stmts=$(grep -c ';' "$src")
+
+  parse=$(best_parse_time "$COMP" "$src")
+  base=
+  [ -n "$BASE" ] && base=$(best_parse_time "$BASE" "$src")
+  if [ "$parse" == failed ] || [ "$base" == failed ]; then
+    printf "%-6s %10s %12s\n" $size $stmts failed
+    echo "$size,$stmts,,," >> "$OUT"
+    continue
+  fi
+  awk -v size=$size -v stmts=$stmts -v parse=$parse -v base="$base" -v out="$OUT" 'BEGIN {
+    speedup = base == "" ? "" : sprintf("%.2f", base / parse)
+    printf "%s,%d,%.4f,%s,%s\n", size, stmts, parse, base, speedup >> out
+    printf "%-6s %10d %12.4f %12s %7s%s\n", size, stmts, parse, base == "" ? "-" : base, speedup == "" ? "-" : speedup, speedup == "" ? "" : "x"
+  }'
+done
@@ -0,0 +1,44 @@
+# Setup shared by the benchmark scripts, each of which sources it before
+# setting its own defaults.
+#
+# Environment:
+#   COMP      mccomp to benchmark (default: the build next to bench)
+#   GEN       program generator (default bench/gen_minic)
+#   REPEAT    timed runs per measurement, the fastest is reported (default 3)
+#   SEED      generator seed (default 1)
+#   GENFLAGS  extra gen_minic knobs, passed on by gen_program
+#   WORKDIR   where generated programs are kept (default: a temporary directory)
+
+BENCH="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+COMP=${COMP:-$BENCH/../mccomp}
+GEN=${GEN:-$BENCH/gen_minic}
+REPEAT=${REPEAT:-3}
+SEED=${SEED:-1}
+
+if [ -z "$WORKDIR" ]; then
+  WORKDIR=$(mktemp -d)
+  trap 'rm -rf "$WORKDIR"' EXIT
+fi
+mkdir -p "$WORKDIR"
+
+# gen_program <src> <gen_minic flags>: generates src unless it is already there
+function gen_program {
+  local src=$1
+  shift
+  [ -f "$src" ] || "$GEN" --seed "$SEED" "$@" $GENFLAGS -o "$src"
+}
+
+# best_time <command>: fastest wall time in ns of REPEAT runs of the command in
+# WORKDIR, or "failed". With CLEAR set, that file is removed before each run
+function best_time {
+  local best= start end ns
+  for ((i = 0; i < REPEAT; i++)); do
+    [ -n "$CLEAR" ] && rm -f "$CLEAR"
+    start=$(date +%s%N)
+    (cd "$WORKDIR" && "$@" > /dev/null 2>&1) || { echo failed; return; }
+    end=$(date +%s%N)
+    ns=$((end - start))
+    if [ -z "$best" ] || [ $ns -lt $best ]; then best=$ns; fi
+  done
+  echo $best
+}
@@ -0,0 +1,422 @@
+//===- gen_minic.cpp - Synthetic Mini-C program generator -----------------===//
+//
+// Generates deterministic, well-typed Mini-C programs conforming to
+// finalGrammar.txt for compile-time benchmarking of mccomp. The same seed and
+// knobs always produce byte-identical output on every platform (the generator
+// uses its own PRNG rather than the implementation-defined <random>
+// distributions).
+//
+// Usage: gen_minic [options] > program.c
+//   --seed N             PRNG seed (default 1)
+//   --size N[K|M|G]      keep emitting functions while the output stays within
+//                        N bytes (overrides --functions)
+//   --functions N        number of function definitions (default 100)
+//   --locals N           local declarations per function (default 6)
+//   --stmts N            statements per block (default 8)
+//   --depth N            maximum if/while nesting depth (default 3)
+//   --expr-len N         operands per expression (default 6)
+//   --literal-density P  percentage of operands that are literals (default 30)
+//   --globals N          global variable declarations (default 8)
+//   -o FILE              write to FILE instead of stdout
+//
+//===----------------------------------------------------------------------===//
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//===----------------------------------------------------------------------===//
+// Generator knobs and state
+//===----------------------------------------------------------------------===//
+
+enum VarType { T_BOOL = 0, T_INT = 1, T_FLOAT = 2, T_VOID = 3 };
+
+static const char *TypeNames[] = {"bool", "int", "float", "void"};
+
+// functions generated and dropped for not fitting in --size before giving up
+static const int MaxSizeMisses = 100;
+
+struct GenOptions {
+  uint64_t Seed = 1;
+  uint64_t TargetSize = 0;
+  int Functions = 100;
+  int Locals = 6;
+  int Stmts = 8;
+  int Depth = 3;
+  int ExprLen = 6;
+  int LiteralDensity = 30;
+  int Globals = 8;
+  const char *Output = nullptr;
+};
+
+struct Var {
+  string Name;
+  VarType Type;
+};
+
+struct Func {
+  string Name;
+  VarType Ret;
+  vector<VarType> Params;
+};
+
+static GenOptions Opts;
+static string Out;
+static vector<Var> Globals;
+static vector<Func> Funcs;
+static vector<Var> Visible; // params and locals in scope in the current function
+static int TempCount = 0;
+static int Indent = 0;
+
+/// splitmix64 - small, fast and identical on every platform.
+static uint64_t RngState;
+static uint64_t nextRand() {
+  uint64_t Z = (RngState += 0x9e3779b97f4a7c15ULL);
+  Z = (Z ^ (Z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  Z = (Z ^ (Z >> 27)) * 0x94d049bb133111ebULL;
+  return Z ^ (Z >> 31);
+}
+// uniform in [0, N)
+static int randBelow(int N) { return N <= 0 ? 0 : (int)(nextRand() % N); }
+// true with the given percentage
+static bool chance(int Percent) { return randBelow(100) < Percent; }
+
+static void line(const string &S) {
+  Out.append(Indent * 2, ' ');
+  Out += S;
+  Out += '\n';
+}
+
+//===----------------------------------------------------------------------===//
+// Expressions
+//===----------------------------------------------------------------------===//
+
+static string literal(VarType T) {
+  switch (T) {
+  case T_BOOL:
+    return chance(50) ? "true" : "false";
+  case T_INT:
+    return to_string(randBelow(1000));
+  default:
+    return to_string(randBelow(1000)) + "." + to_string(randBelow(100));
+  }
+}
+
+// any visible variable (locals, params, globals) whose type widens to T
+static const Var *pickVar(VarType T, bool Exact) {
+  vector<const Var *> Candidates;
+  for (const Var &V : Visible)
+    if (V.Type == T || (!Exact && V.Type < T))
+      Candidates.push_back(&V);
+  for (const Var &V : Globals)
+    if (V.Type == T || (!Exact && V.Type < T))
+      Candidates.push_back(&V);
+  if (Candidates.empty())
+    return nullptr;
+  return Candidates[randBelow(Candidates.size())];
+}
+
+static string expr(VarType T, int Len);
+
+// a literal, variable or parenthesised sub-expression of type T
+static string atom(VarType T, int Budget) {
+  if (Budget > 2 && chance(15))
+    return "(" + expr(T, Budget / 2) + ")";
+  if (!chance(Opts.LiteralDensity)) {
+    if (const Var *V = pickVar(T, T == T_BOOL))
+      return V->Name;
+  }
+  return literal(T);
+}
+
+// an atom, occasionally negated; prefix operators are never stacked
+static string operand(VarType T, int Budget) {
+  if (T == T_BOOL && chance(10))
+    return "!" + atom(T, Budget);
+  if (T != T_BOOL && chance(5)) {
+    const Var *V = pickVar(T, true);
+    return "-" + (V && chance(50) ? V->Name : literal(T));
+  }
+  return atom(T, Budget);
+}
+
+static string arithmetic(VarType T, int Len) {
+  static const char *IntOps[] = {" + ", " - ", " * ", " / ", " % "};
+  static const char *FloatOps[] = {" + ", " - ", " * ", " / "};
+  string S = operand(T, Len);
+  for (int I = 1; I < Len; I++) {
+    const char *Op = T == T_INT ? IntOps[randBelow(5)] : FloatOps[randBelow(4)];
+    // divisors are always non-zero literals so the semantic pass never
+    // rejects a constant division by zero
+    if (Op[1] == '/' || Op[1] == '%')
+      S += Op + to_string(1 + randBelow(99));
+    else
+      S += Op + operand(T, Len - I);
+  }
+  return S;
+}
+
+static string comparison(int Len) {
+  static const char *CmpOps[] = {" < ", " <= ", " > ", " >= ", " == ", " != "};
+  VarType T = chance(70) ? T_INT : T_FLOAT;
+  int Half = Len / 2 > 0 ? Len / 2 : 1;
+  return arithmetic(T, Half) + CmpOps[randBelow(6)] + arithmetic(T, Half);
+}
+
+static string expr(VarType T, int Len) {
+  if (Len < 1)
+    Len = 1;
+  if (T != T_BOOL)
+    return arithmetic(T, Len);
+
+  // boolean expressions are comparisons and bool operands joined by && / ||
+  string S;
+  int Terms = 1 + randBelow(Len / 3 + 1);
+  for (int I = 0; I < Terms; I++) {
+    if (I)
+      S += chance(50) ? " && " : " || ";
+    S += chance(70) ? comparison(Len / Terms) : operand(T_BOOL, Len / Terms);
+  }
+  return S;
+}
+
+//===----------------------------------------------------------------------===//
+// Statements
+//===----------------------------------------------------------------------===//
+
+// calls are only emitted as a whole statement or the whole right-hand side of
+// an assignment, with simple operands as arguments
+static string call(const Func &F) {
+  string S = F.Name + "(";
+  for (size_t I = 0; I < F.Params.size(); I++) {
+    if (I)
+      S += ", ";
+    S += operand(F.Params[I], 1);
+  }
+  return S + ")";
+}
+
+static const Func *pickCallee(VarType T) {
+  if (Funcs.size() <= 1 || !chance(20))
+    return nullptr;
+  // only functions defined before the current one
+  const Func &F = Funcs[randBelow(Funcs.size() - 1)];
+  if (T == T_VOID ? F.Ret != T_VOID : (F.Ret == T_VOID || F.Ret > T))
+    return nullptr;
+  return &F;
+}
+
+static void assignment() {
+  const Var *Target = pickVar((VarType)randBelow(3), true);
+  if (!Target)
+    return;
+  if (const Func *F = pickCallee(Target->Type))
+    line(Target->Name + " = " + call(*F) + ";");
+  else
+    line(Target->Name + " = " + expr(Target->Type, Opts.ExprLen) + ";");
+}
+
+static void block(VarType Ret, int Depth, const string &Tail = "");
+
+static void statement(VarType Ret, int Depth) {
+  int Kind = randBelow(100);
+  if (Depth < Opts.Depth && Kind < 12) {
+    line("if (" + expr(T_BOOL, Opts.ExprLen) + ") {");
+    block(Ret, Depth + 1);
+    if (chance(50)) {
+      line("} else {");
+      block(Ret, Depth + 1);
+    }
+    line("}");
+  } else if (Depth < Opts.Depth && Kind < 20) {
+    // bounded loop over a fresh counter
+    string Counter = "i" + to_string(TempCount++);
+    Visible.push_back({Counter, T_INT});
+    line("{");
+    Indent++;
+    line("int " + Counter + ";");
+    line(Counter + " = 0;");
+    line("while (" + Counter + " < " + to_string(1 + randBelow(16)) + ") {");
+    block(Ret, Depth + 1, Counter + " = " + Counter + " + 1;");
+    line("}");
+    Indent--;
+    line("}");
+    Visible.pop_back();
+  } else if (Kind < 24) {
+    if (const Func *F = pickCallee(T_VOID))
+      line(call(*F) + ";");
+    else
+      assignment();
+  } else {
+    assignment();
+  }
+}
+
+static void block(VarType Ret, int Depth, const string &Tail) {
+  Indent++;
+  size_t Scope = Visible.size();
+  if (chance(30)) {
+    Var V = {"t" + to_string(TempCount++), (VarType)randBelow(3)};
+    line(string(TypeNames[V.Type]) + " " + V.Name + ";");
+    Visible.push_back(V);
+  }
+  int N = 1 + randBelow(Opts.Stmts);
+  for (int I = 0; I < N; I++)
+    statement(Ret, Depth);
+  // loop bodies keep their counter increment reachable; other nested blocks
+  // occasionally return early
+  if (!Tail.empty())
+    line(Tail);
+  else if (chance(10))
+    line(Ret == T_VOID ? "return;"
+                       : "return " + expr(Ret, Opts.ExprLen) + ";");
+  Visible.resize(Scope);
+  Indent--;
+}
+
+static void function(int Index) {
+  Func F;
+  F.Name = "f" + to_string(Index);
+  F.Ret = (VarType)randBelow(4);
+  int NumParams = randBelow(4);
+  for (int I = 0; I < NumParams; I++)
+    F.Params.push_back((VarType)randBelow(3));
+  Funcs.push_back(F);
+
+  Visible.clear();
+  TempCount = 0;
+  string Header = string(TypeNames[F.Ret]) + " " + F.Name + "(";
+  for (int I = 0; I < NumParams; I++) {
+    Var P = {"p" + to_string(I), F.Params[I]};
+    Visible.push_back(P);
+    Header += string(I ? ", " : "") + TypeNames[P.Type] + " " + P.Name;
+  }
+  line(Header + ") {");
+
+  Indent++;
+  for (int I = 0; I < Opts.Locals; I++) {
+    // the first three locals cover every type so assignments always have a
+    // target
+    Var V = {"v" + to_string(I), (VarType)(I < 3 ? I : randBelow(3))};
+    line(string(TypeNames[V.Type]) + " " + V.Name + ";");
+    Visible.push_back(V);
+  }
+  Indent--;
+
+  int N = 1 + randBelow(Opts.Stmts);
+  for (int I = 0; I < N; I++) {
+    Indent++;
+    statement(F.Ret, 0);
+    Indent--;
+  }
+  Indent++;
+  line(F.Ret == T_VOID ? "return;"
+                       : "return " + expr(F.Ret, Opts.ExprLen) + ";");
+  Indent--;
+  line("}");
+  line("");
+}
+
+//===----------------------------------------------------------------------===//
+// Main driver
+//===----------------------------------------------------------------------===//
+
+static uint64_t parseSize(const char *S) {
+  char *End;
+  uint64_t N = strtoull(S, &End, 10);
+  switch (*End) {
+  case 'k': case 'K': return N << 10;
+  case 'm': case 'M': return N << 20;
+  case 'g': case 'G': return N << 30;
+  default: return N;
+  }
+}
+
+static void usage() {
+  fprintf(stderr,
+          "Usage: gen_minic [--seed N] [--size N[K|M|G]] [--functions N] "
+          "[--locals N] [--stmts N] [--depth N] [--expr-len N] "
+          "[--literal-density P] [--globals N] [-o FILE]\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    string Arg = argv[i];
+    if (i + 1 >= argc)
+      usage();
+    const char *Val = argv[++i];
+    if (Arg == "--seed")
+      Opts.Seed = strtoull(Val, nullptr, 10);
+    else if (Arg == "--size")
+      Opts.TargetSize = parseSize(Val);
+    else if (Arg == "--functions")
+      Opts.Functions = atoi(Val);
+    else if (Arg == "--locals")
+      Opts.Locals = atoi(Val) < 3 ? 3 : atoi(Val);
+    else if (Arg == "--stmts")
+      Opts.Stmts = atoi(Val) < 1 ? 1 : atoi(Val);
+    else if (Arg == "--depth")
+      Opts.Depth = atoi(Val);
+    else if (Arg == "--expr-len")
+      Opts.ExprLen = atoi(Val) < 1 ? 1 : atoi(Val);
+    else if (Arg == "--literal-density")
+      Opts.LiteralDensity = atoi(Val);
+    else if (Arg == "--globals")
+      Opts.Globals = atoi(Val);
+    else if (Arg == "-o")
+      Opts.Output = Val;
+    else
+      usage();
+  }
+
+  RngState = Opts.Seed;
+  FILE *F = Opts.Output ? fopen(Opts.Output, "w") : stdout;
+  if (!F) {
+    perror(Opts.Output);
+    return 1;
+  }
+
+  line("// generated by gen_minic --seed " + to_string(Opts.Seed));
+  line("extern int print_int(int X);");
+  line("extern float print_float(float X);");
+  line("");
+  for (int I = 0; I < Opts.Globals; I++) {
+    Var G = {"g" + to_string(I), (VarType)(I % 3)};
+    line(string(TypeNames[G.Type]) + " " + G.Name + ";");
+    Globals.push_back(G);
+  }
+  line("");
+
+  // flush periodically so multi-gigabyte programs never sit in memory
+  uint64_t Written = 0;
+  int Misses = 0;
+  for (int I = 0; Opts.TargetSize ? Misses < MaxSizeMisses : I < Opts.Functions;
+       I++) {
+    size_t Start = Out.size();
+    function(I);
+    // with --size, a function that would overshoot the target is dropped and
+    // another one tried in its place, as a smaller one may still fit
+    if (Opts.TargetSize && Written + Out.size() > Opts.TargetSize) {
+      Out.resize(Start);
+      Funcs.pop_back();
+      Misses++;
+      I--;
+      continue;
+    }
+    if (Out.size() > (1 << 20)) {
+      fwrite(Out.data(), 1, Out.size(), F);
+      Written += Out.size();
+      Out.clear();
+    }
+  }
+  fwrite(Out.data(), 1, Out.size(), F);
+  if (F != stdout)
+    fclose(F);
+  return 0;
+}
@@ -0,0 +1,40 @@
+// MiniC benchmark kernel: sum of cosine(x) at samples points in [0, pi), each
+// computed from the alternating series to within tolerance eps
+
+float cosine(int samples) {
+
+  float x;
+  float cos;
+  float n;
+  float term;
+  float eps;
+  float alt;
+  float sum;
+  float halfturn;
+  int k;
+
+  eps = 0.000001;
+  halfturn = 3.14159;    // a float variable, so C also computes x in float
+  sum = 0.0;
+  k = 0;
+
+  while (k < samples) {
+    x = halfturn * k / samples;
+    n = 1.0;
+    cos = 1.0;
+    term = 1.0;
+    alt = -1.0;
+
+    while (term > eps) {
+      term = term * x * x / n / (n+1);
+      cos = cos + alt * term;
+      alt = -alt;
+      n = n + 2;
+    }
+
+    sum = sum + cos;
+    k = k + 1;
+  }
+
+  return sum;
+}
@@ -0,0 +1,193 @@
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Runtime benchmark driver: times each kernel in a loop and prints
+// "kernel,ns_per_call,result,cycles,instructions,branch_misses,l1d_misses"
+// lines. The hardware counters are per call; they are left empty when
+// perf_event_open is unavailable (non-Linux, a container without a PMU or
+// perf_event_paranoid forbidding it).
+//
+// clang++ -O2 driver.cpp factorial.o fibonacci.o pi.o cosine.o palindrome.o -o bench
+// ./bench [kernel...]
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+extern "C" DLLEXPORT int print_int(int X) {
+  fprintf(stderr, "%d\n", X);
+  return 0;
+}
+
+extern "C" DLLEXPORT float print_float(float X) {
+  fprintf(stderr, "%f\n", X);
+  return 0;
+}
+
+extern "C" {
+    int factorial(int limit);
+    int fibonacci(int n);
+    float pi(int terms);
+    float cosine(int samples);
+    int palindrome(int lo, int hi);
+}
+
+// the kernels live in separately compiled objects, so the calls below cannot
+// be hoisted out of the timing loop
+static double runFactorial() { return factorial(2000); }
+static double runFibonacci() { return fibonacci(1000000); }
+static double runPi() { return pi(1000000); }
+static double runCosine() { return cosine(100000); }
+static double runPalindrome() { return palindrome(1000000, 1200000); }
+
+struct Kernel {
+  const char *Name;
+  double (*Run)();
+};
+
+static Kernel Kernels[] = {
+  {"factorial", runFactorial},
+  {"fibonacci", runFibonacci},
+  {"pi", runPi},
+  {"cosine", runCosine},
+  {"palindrome", runPalindrome},
+};
+
+static volatile double Sink;
+
+//===----------------------------------------------------------------------===//
+// Hardware performance counters
+//===----------------------------------------------------------------------===//
+
+enum Counter { CYCLES, INSTRUCTIONS, BRANCH_MISSES, L1D_MISSES, NUM_COUNTERS };
+
+static const char *CounterNames[NUM_COUNTERS] = {"cycles", "instructions", "branch-misses", "L1d-misses"};
+
+static int CounterFds[NUM_COUNTERS] = {-1, -1, -1, -1};
+
+#ifdef __linux__
+static int openCounter(uint32_t Type, uint64_t Config) {
+  perf_event_attr Attr;
+  memset(&Attr, 0, sizeof(Attr));
+  Attr.size = sizeof(Attr);
+  Attr.type = Type;
+  Attr.config = Config;
+  Attr.disabled = 1;
+  Attr.exclude_kernel = 1;
+  Attr.exclude_hv = 1;
+  // scale for multiplexing when more events are open than hardware counters
+  Attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return syscall(SYS_perf_event_open, &Attr, 0, -1, -1, 0);
+}
+#endif
+
+// open every counter that the kernel and hardware allow; the others stay -1
+static void openCounters() {
+  int Errors[NUM_COUNTERS] = {ENOSYS, ENOSYS, ENOSYS, ENOSYS};
+#ifdef __linux__
+  uint64_t L1dReadMiss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  uint32_t Types[NUM_COUNTERS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE};
+  uint64_t Configs[NUM_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                    PERF_COUNT_HW_BRANCH_MISSES, L1dReadMiss};
+  for (int i = 0; i < NUM_COUNTERS; i++)
+    if ((CounterFds[i] = openCounter(Types[i], Configs[i])) < 0)
+      Errors[i] = errno;
+#endif
+  for (int i = 0; i < NUM_COUNTERS; i++)
+    if (CounterFds[i] < 0)
+      fprintf(stderr, "warning: %s counter unavailable (%s)\n", CounterNames[i], strerror(Errors[i]));
+}
+
+static void startCounters() {
+#ifdef __linux__
+  for (int Fd : CounterFds)
+    if (Fd >= 0) {
+      ioctl(Fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(Fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+// Values[i] is -1 for counters that are unavailable
+static void stopCounters(double Values[NUM_COUNTERS]) {
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    Values[i] = -1;
+#ifdef __linux__
+    if (CounterFds[i] < 0)
+      continue;
+    ioctl(CounterFds[i], PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t Data[3]; // value, time enabled, time running
+    if (read(CounterFds[i], Data, sizeof(Data)) == sizeof(Data) && Data[2] != 0)
+      Values[i] = double(Data[0]) * Data[1] / Data[2];
+#endif
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Timing
+//===----------------------------------------------------------------------===//
+
+// batches of calls are grown until one takes at least MinBatchNs; the fastest
+// per-call time over the measured batches is reported, with the counters of
+// that batch
+static double timeKernel(const Kernel &K, int Batches, double MinBatchNs, double Counters[NUM_COUNTERS]) {
+  using Clock = std::chrono::steady_clock;
+  long Calls = 1;
+  double Best = 0;
+  for (int Measured = 0; Measured < Batches;) {
+    double Values[NUM_COUNTERS];
+    startCounters();
+    auto Start = Clock::now();
+    for (long i = 0; i < Calls; i++)
+      Sink = K.Run();
+    double Ns = std::chrono::duration<double, std::nano>(Clock::now() - Start).count();
+    stopCounters(Values);
+    if (Ns < MinBatchNs) {
+      Calls *= 2;
+      continue;
+    }
+    if (Measured++ == 0 || Ns / Calls < Best) {
+      Best = Ns / Calls;
+      for (int i = 0; i < NUM_COUNTERS; i++)
+        Counters[i] = Values[i] < 0 ? -1 : Values[i] / Calls;
+    }
+  }
+  return Best;
+}
+
+int main(int argc, char **argv) {
+  int Batches = getenv("BENCH_BATCHES") ? atoi(getenv("BENCH_BATCHES")) : 5;
+  double MinBatchMs = getenv("BENCH_MIN_BATCH_MS") ? atof(getenv("BENCH_MIN_BATCH_MS")) : 50;
+
+  openCounters();
+  printf("kernel,ns_per_call,result,cycles,instructions,branch_misses,l1d_misses\n");
+  for (const Kernel &K : Kernels) {
+    bool Selected = argc == 1;
+    for (int i = 1; i < argc; i++)
+      Selected |= strcmp(argv[i], K.Name) == 0;
+    if (!Selected)
+      continue;
+
+    double Counters[NUM_COUNTERS];
+    double Ns = timeKernel(K, Batches, MinBatchMs * 1e6, Counters);
+    printf("%s,%.1f,%.6g", K.Name, Ns, K.Run());
+    for (double C : Counters)
+      C < 0 ? printf(",") : printf(",%.0f", C);
+    printf("\n");
+    fflush(stdout);
+  }
+}
@@ -0,0 +1,24 @@
+// MiniC benchmark kernel: sum of n! modulo a prime for every n up to limit
+int factorial(int limit)
+{
+    int n;
+    int i;
+    int factorial;
+    int sum;
+
+    sum = 0;
+    n = 1;
+
+    while (n <= limit) {
+      factorial = 1;
+      i = 1;
+      while (i <= n) {
+        factorial = factorial * i % 1000003;   // stays below 2^31 for limit <= 2000
+        i = i + 1;
+      }
+      sum = (sum + factorial) % 1000003;
+      n = n + 1;
+    }
+
+    return sum;
+}
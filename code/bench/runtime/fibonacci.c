@@ -0,0 +1,29 @@
+// MiniC benchmark kernel: sum of the first n fibonacci numbers modulo 10^9+7
+
+int fibonacci(int n)
+{
+  int first;
+  int second;
+  int next;
+  int c;
+  int total;
+
+  first = 0;
+  second = 1;
+  c = 1;
+  total = 0;
+
+  while(c < n) {
+    if (c <= 1) {
+      next = c;
+    }
+    else {
+      next = (first + second) % 1000000007;
+      first = second;
+      second = next;
+    }
+    c = c + 1;
+    total = (total + next) % 1000000007;
+  }
+  return total;
+}
@@ -0,0 +1,31 @@
+// MiniC benchmark kernel: count the palindromic numbers in [lo, hi)
+
+int palindrome(int lo, int hi) {
+
+   int number;
+   int t;
+   int rev;
+   int rmndr;
+   int count;
+
+   count = 0;
+   t = lo;
+
+   while (t < hi)
+   {
+      number = t;
+      rev = 0;
+      while (number > 0)
+      {
+         rmndr = number%10;
+         rev = rev*10 + rmndr;
+         number = number/10;
+      }
+
+      if(t == rev) {
+         count = count + 1;
+      }
+      t = t + 1;
+   }
+   return count;
+}
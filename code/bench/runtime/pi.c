@@ -0,0 +1,34 @@
+// MiniC benchmark kernel: value of pi from the first terms of the Nilakantha series
+
+float pi(int terms) {
+
+  bool flag;
+  float PI;
+  float f;
+  float one;
+  float two;
+  float four;
+  int i;
+
+  flag = true;
+  PI = 3.0;
+  i = 2;
+  one = 1.0;    // float constants in variables, so C also computes in float
+  two = 2.0;
+  four = 4.0;
+
+  while(i < terms) {
+    f = i;    // float, so i*(i+1)*(i+2) cannot overflow
+
+    if(flag) {
+      PI = PI + (four / (f*(f+one)*(f+two)));
+    }
+    else {
+      PI = PI - (four / (f*(f+one)*(f+two)));
+    }
+    flag = !flag;
+    i = i+2;
+  }
+
+  return PI;
+}
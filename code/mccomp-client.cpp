@@ -0,0 +1,113 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Client for the mccomp compile server. It forwards its command line to a
+// server started with `mccomp --server`, which compiles the file in the
+// client's working directory, writing the diagnostics to the client's stdout
+// and stderr. The client exits with the compiler's exit code.
+//
+// ./mccomp-client [--socket=<path>] [mccomp flags] InputFile
+//
+// The socket defaults to $MCCOMP_SOCKET, or mccomp.sock in $XDG_RUNTIME_DIR or
+// in /tmp/mccomp-<uid>, as for the server. See "Compile server" in mccomp.cpp
+// for the protocol. The client only talks to a server run by the same user,
+// as the server gets access to its stdout, stderr and working directory.
+
+static std::string defaultSocket() {
+  if (const char *Socket = getenv("MCCOMP_SOCKET"))
+    return Socket;
+  const char *RuntimeDir = getenv("XDG_RUNTIME_DIR");
+  if (RuntimeDir && *RuntimeDir)
+    return std::string(RuntimeDir) + "/mccomp.sock";
+  return "/tmp/mccomp-" + std::to_string(getuid()) + "/mccomp.sock";
+}
+
+static bool writeAll(int Fd, const char *Data, size_t Size) {
+  while (Size != 0) {
+    ssize_t N = write(Fd, Data, Size);
+    if (N < 0 && errno == EINTR)
+      continue;
+    if (N <= 0)
+      return false;
+    Data += N;
+    Size -= N;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  std::string SocketPath = defaultSocket();
+  std::string Payload; // the arguments, each terminated by '\0'
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--socket=", 9) == 0)
+      SocketPath = argv[i] + 9;
+    else
+      Payload.append(argv[i], strlen(argv[i]) + 1);
+  }
+
+  sockaddr_un Addr = {};
+  Addr.sun_family = AF_UNIX;
+  if (SocketPath.size() >= sizeof(Addr.sun_path)) {
+    fprintf(stderr, "mccomp-client: socket path too long: %s\n", SocketPath.c_str());
+    return 1;
+  }
+  strcpy(Addr.sun_path, SocketPath.c_str());
+  int Conn = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (Conn < 0 || connect(Conn, (sockaddr *)&Addr, sizeof(Addr)) != 0) {
+    fprintf(stderr, "mccomp-client: cannot connect to %s: %s (start the server with mccomp --server)\n",
+            SocketPath.c_str(), strerror(errno));
+    return 1;
+  }
+  ucred Cred;
+  socklen_t CredSize = sizeof(Cred);
+  if (getsockopt(Conn, SOL_SOCKET, SO_PEERCRED, &Cred, &CredSize) != 0 || Cred.uid != getuid()) {
+    fprintf(stderr, "mccomp-client: the server on %s is not run by this user\n", SocketPath.c_str());
+    return 1;
+  }
+
+  int Cwd = open(".", O_RDONLY | O_DIRECTORY);
+  if (Cwd < 0) {
+    perror("mccomp-client: cannot open the working directory");
+    return 1;
+  }
+  int Fds[3] = {STDOUT_FILENO, STDERR_FILENO, Cwd};
+
+  // the size goes first, carrying the file descriptors
+  uint32_t Size = Payload.size();
+  iovec Iov = {&Size, sizeof(Size)};
+  alignas(cmsghdr) char Control[CMSG_SPACE(sizeof(Fds))] = {};
+  msghdr Msg = {};
+  Msg.msg_iov = &Iov;
+  Msg.msg_iovlen = 1;
+  Msg.msg_control = Control;
+  Msg.msg_controllen = sizeof(Control);
+  cmsghdr *Cmsg = CMSG_FIRSTHDR(&Msg);
+  Cmsg->cmsg_level = SOL_SOCKET;
+  Cmsg->cmsg_type = SCM_RIGHTS;
+  Cmsg->cmsg_len = CMSG_LEN(sizeof(Fds));
+  memcpy(CMSG_DATA(Cmsg), Fds, sizeof(Fds));
+  if (sendmsg(Conn, &Msg, 0) != sizeof(Size) || !writeAll(Conn, Payload.data(), Payload.size())) {
+    perror("mccomp-client: cannot send the request");
+    return 1;
+  }
+
+  int32_t Status;
+  ssize_t N;
+  while ((N = recv(Conn, &Status, sizeof(Status), MSG_WAITALL)) < 0 && errno == EINTR)
+    ;
+  if (N != sizeof(Status)) {
+    fprintf(stderr, "mccomp-client: the server did not finish the compile (it may have crashed)\n");
+    return 1;
+  }
+  return Status;
+}
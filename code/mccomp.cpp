@@ -1,5 +1,11 @@
 #include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/CodeGen/ParallelCG.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
@@ -9,25 +15,56 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/PassTimingInfo.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/CachePruning.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA1.h"
 #include "llvm/TargetParser/Host.h"
 #include "llvm/MC/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/thread.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
+#include "llvm/Transforms/InstCombine/InstCombine.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Scalar/GVN.h"
+#include "llvm/Transforms/Utils.h"
 #include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <chrono>
+#include <climits>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <fcntl.h>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <optional>
 #include <queue>
+#include <set>
 #include <string.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 #include <string>
 #include <system_error>
 #include <utility>
@@ -40,6 +77,149 @@ using namespace std;
 
 FILE *pFile;
 
+//===----------------------------------------------------------------------===//
+// Compile-time reporting - phase timers for --time-report, spans for --time-trace and counters for --stats
+//===----------------------------------------------------------------------===//
+
+enum COMPILE_PHASE {
+  PHASE_LEX_VALIDATE, //first pass over the file, which only looks for invalid tokens
+  PHASE_LEX, //lexing the tokens read by the parser
+  PHASE_PARSE,
+  PHASE_SEMA,
+  PHASE_FOLD,
+  PHASE_CODEGEN,
+  PHASE_VERIFY,
+  PHASE_OPT,
+  PHASE_PRINT_AST,
+  PHASE_OUTPUT, //writing output.ll
+  PHASE_BACKEND, //native code generation for --emit=obj
+  PHASE_CACHE, //looking up and storing the output in the --cache-dir cache
+  NUM_PHASES
+};
+
+static const char *PhaseNames[NUM_PHASES][2] = {
+  {"lex-validate", "Lexer validation pass"},
+  {"lex", "Lexing (during parsing)"},
+  {"parse", "Parsing"},
+  {"sema", "Semantic analysis"},
+  {"fold", "Constant folding"},
+  {"codegen", "IR code generation"},
+  {"verify", "IR verification"},
+  {"opt", "Optimisation"},
+  {"print-ast", "AST printing"},
+  {"output", "Writing output.ll"},
+  {"backend", "Native code generation"},
+  {"cache", "Compilation cache"}
+};
+
+/// FunctionStats - size of the IR of one function, as generated and after the -O1/-O2 pipeline
+struct FunctionStats {
+  string Name;
+  unsigned Blocks, Instructions;
+  unsigned OptBlocks, OptInstructions;
+};
+
+/// CompileStats - counters printed by --stats and --stats-json. They are cheap enough to always be updated
+struct CompileStats {
+  unsigned long Tokens = 0; //tokens in the file, not counting EOF
+  unsigned long Expressions = 0; //expressions built by createExprASTnode() from a list of tokens
+  unsigned long ExpressionTokens = 0;
+  unsigned long MaxExpressionTokens = 0;
+  unsigned long VariableLookups = 0;
+  unsigned long ScopesSearched = 0; //symbol tables searched by variable lookups, including the global one
+  unsigned long FunctionLookups = 0;
+  unsigned long MaxScopeDepth = 0; //most local symbol tables in use at once
+  unsigned long FunctionCacheHits = 0; //function definitions reused from the function cache (--incremental)
+  unsigned long FunctionCacheMisses = 0;
+  unsigned long LazyBodiesParsed = 0; //function bodies parsed with --lazy-bodies, as they are reachable from the roots
+  unsigned long LazyBodiesDropped = 0; //function definitions dropped with --lazy-bodies without parsing their bodies
+  long PhaseRSS[NUM_PHASES] = {}; //largest resident set size of the process at the end of each outermost phase, in KB
+  vector<FunctionStats> Functions; //only filled in for --stats and --stats-json
+};
+
+static CompileStats Stats;
+static bool StatsEnabled = false; //set by --stats and --stats-json
+
+static std::unique_ptr<TimerGroup> PhaseTimerGroup; //only created for --time-report
+static std::unique_ptr<Timer> PhaseTimers[NUM_PHASES];
+static vector<Timer*> ActivePhases; //stack of the phases that are running, innermost last
+static int PhaseDepth = 0; //number of phases running on the main thread, whether or not they are timed
+static std::chrono::steady_clock::duration ExprBuildTime{}; //building expression ASTs, which --time-report counts as parsing
+static thread_local bool IsWorkerThread = false; //set on the threads of the parallel parser and code generator (-j), which are timed as part of the main thread's phase
+static int StatmFD = -1; //kept open, as the resident set size is read at the end of every outermost phase with --stats
+static pid_t StatmPid = 0; //process StatmFD was opened in, as a forked compile server worker must open its own
+
+//current resident set size of the process in KB, from /proc/self/statm (0 if it cannot be read)
+static long getCurrentRSS() {
+  if(StatmPid != getpid())
+  {
+    if(StatmFD >= 0)
+      close(StatmFD);
+    StatmFD = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    StatmPid = getpid();
+  }
+  char buf[128];
+  ssize_t len = StatmFD < 0 ? -1 : pread(StatmFD, buf, sizeof(buf) - 1, 0);
+  if(len <= 0)
+    return 0;
+  buf[len] = '\0';
+  long size = 0, resident = 0; //in pages
+  if(sscanf(buf, "%ld %ld", &size, &resident) != 2)
+    return 0;
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+//peak resident set size over the whole life of the process in KB - ru_maxrss only ever grows, so it cannot be split by phase
+static long getPeakRSS() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+static void InitializePhaseTimers() {
+  PhaseTimerGroup = std::make_unique<TimerGroup>("mccomp", "Mini-C compiler phases");
+  for(int i = 0; i < NUM_PHASES; i++)
+    PhaseTimers[i] = std::make_unique<Timer>(PhaseNames[i][0], PhaseNames[i][1], *PhaseTimerGroup);
+}
+
+/// CompilePhase - RAII helper that times a phase of the compiler, and adds a span for it to the --time-trace output.
+/// Phases nest: the enclosing phase is paused while an inner one runs, so each phase is reported without its inner phases.
+class CompilePhase {
+  COMPILE_PHASE Phase;
+  Timer *PhaseTimer = nullptr;
+  std::optional<TimeTraceScope> TraceScope;
+
+public:
+  CompilePhase(COMPILE_PHASE phase, StringRef detail = "", bool trace = true) : Phase(phase) {
+    if(!IsWorkerThread)
+      PhaseDepth++;
+    if(PhaseTimerGroup && !IsWorkerThread)
+    {
+      if(!ActivePhases.empty())
+        ActivePhases.back()->stopTimer();
+      PhaseTimer = PhaseTimers[phase].get();
+      PhaseTimer->startTimer();
+      ActivePhases.push_back(PhaseTimer);
+    }
+    if(trace && timeTraceProfilerEnabled())
+      TraceScope.emplace(PhaseNames[phase][1], detail);
+  }
+
+  ~CompilePhase() {
+    if(PhaseTimer)
+    {
+      PhaseTimer->stopTimer();
+      ActivePhases.pop_back();
+      if(!ActivePhases.empty())
+        ActivePhases.back()->startTimer();
+    }
+    //the resident set size is only sampled when an outermost phase ends: nested phases such as the lexer's batches
+    //and each function's code generation end far too often for reading /proc to be cheap
+    if(!IsWorkerThread && --PhaseDepth == 0 && StatsEnabled)
+      Stats.PhaseRSS[Phase] = std::max(Stats.PhaseRSS[Phase], getCurrentRSS());
+  }
+};
+
 //===----------------------------------------------------------------------===//
 // Lexer
 //===----------------------------------------------------------------------===//
@@ -406,18 +586,49 @@ static TOKEN gettok() {
 /// CurTok/getNextToken - Provide a simple token buffer.  CurTok is the current
 /// token the parser is looking at.  getNextToken reads another token from the
 /// lexer and updates CurTok with its results.
-static TOKEN CurTok;
-static std::deque<TOKEN> tok_buffer;
+static thread_local TOKEN CurTok;
+static thread_local std::deque<TOKEN> tok_buffer;
+static thread_local bool ReplayingTokens = false; //the buffer holds the skimmed tokens of a function body, ending with EOF, and is not refilled from the lexer
+
+static COMPILE_PHASE LexPhase = PHASE_LEX_VALIDATE; //phase that the time spent in gettok() is reported under
+static const int LexBatchSize = 64; //the lexer does not depend on the parser, so tokens can be read ahead in batches
+
+//with --incremental, the tokens of the top-level declaration being parsed are recorded, so that each function
+//definition can be keyed in the function cache by its tokens
+static bool RecordTokens = false;
+static string RecordedTokens;
+static size_t RecordedTokensEnd = 0; //end of the tokens before CurTok, which is a lookahead past the declaration once it has been parsed
+static std::set<string> RecordedIdentifiers;
+
+static void recordToken(const TOKEN &tok) {
+  RecordedTokensEnd = RecordedTokens.size();
+  RecordedTokens += std::to_string(tok.type) + ' ' + tok.lexeme + '\0';
+  if(tok.type == IDENT)
+    RecordedIdentifiers.insert(tok.lexeme);
+}
 
+static void startRecordingDecl() {
+  RecordedTokens.clear();
+  RecordedIdentifiers.clear();
+  recordToken(CurTok); //the first token of the declaration has already been read
+}
 static TOKEN getNextToken() {
 
-  while(tok_buffer.size() != 2) //store two lookahead tokens
-    tok_buffer.push_back(gettok());
+  if(tok_buffer.size() < 2 && !ReplayingTokens) //store at least two lookahead tokens
+  {
+    CompilePhase phase(LexPhase, "", false); //timed per batch rather than per token, which would cost more than lexing it
+    for(int i = 0; i < LexBatchSize; i++)
+      tok_buffer.push_back(gettok());
+  }
 
   TOKEN temp = tok_buffer.front();
-  tok_buffer.pop_front();
+  if(tok_buffer.size() > 1 || !ReplayingTokens) //the EOF at the end of replayed tokens stays in the buffer
+    tok_buffer.pop_front();
 
-  return CurTok = temp;
+  CurTok = temp;
+  if(RecordTokens)
+    recordToken(CurTok);
+  return CurTok;
 }
 
 static void putBackToken(TOKEN tok) { tok_buffer.push_front(tok); } //return token to buffer after looking-ahead two tokens
@@ -466,16 +677,138 @@ void resetIndent()
   indentLevel = 0;
 }
 
+/// MiniCType - type of an expression, numbered in the order of the widening conversions (bool -> int -> float)
+enum MiniCType {
+  NO_TYPE = -1, //not resolved yet, or not an expression
+  BOOL_TYPE = 0,
+  INT_TYPE = 1,
+  FLOAT_TYPE = 2,
+  VOID_TYPE = 3 //result of calling a void function
+};
+
+//converts a type name used in the source (and in the AST) to a MiniCType
+static MiniCType getMiniCType(const string &type)
+{
+  if(type == "bool")
+    return BOOL_TYPE;
+  else if(type == "int")
+    return INT_TYPE;
+  else if(type == "float")
+    return FLOAT_TYPE;
+  else if(type == "void")
+    return VOID_TYPE;
+  return NO_TYPE;
+}
+
+static string getTypeName(MiniCType type)
+{
+  switch(type)
+  {
+    case BOOL_TYPE: return "bool";
+    case INT_TYPE: return "int";
+    case FLOAT_TYPE: return "float";
+    case VOID_TYPE: return "void";
+    default: return "";
+  }
+}
+
+/// ConstantValue - value of a literal, as used by the constant folder. Bools are stored in IntVal as 0 or 1
+struct ConstantValue {
+  MiniCType Type;
+  int IntVal;
+  float FloatVal;
+};
+
+struct ASTWriter;
+
 /// ASTnode - Base class for all AST child nodes.
 class ASTnode {
 public:
+  /// ASTnodeKind - identifies the class of an AST node, so that isa<> and dyn_cast<> can be used on AST nodes (RTTI is disabled)
+  enum ASTnodeKind {
+    IntKind,
+    FloatKind,
+    BoolKind,
+    VariableKind,
+    VariableReferenceKind,
+    UnaryExprKind,
+    BinaryExprKind,
+    FuncCallKind,
+    ImplicitCastKind,
+    IfExprKind,
+    WhileExprKind,
+    ReturnExprKind,
+    NumKinds
+  };
+
+  static thread_local unsigned long NodesCreated[NumKinds]; //for --stats, per thread as bodies may be parsed on worker threads
+
+private:
+  const ASTnodeKind Kind;
+
+protected:
+  MiniCType ExprType = NO_TYPE; //type of the expression, resolved by checkSemantics()
+
+public:
+  ASTnode(ASTnodeKind kind) : Kind(kind) { NodesCreated[kind]++; }
+  ASTnodeKind getKind() const { return Kind; }
+  MiniCType getExprType() const { return ExprType; }
+  void setExprType(MiniCType type) { ExprType = type; } //for nodes loaded from the AST cache, which have already been checked
+
   virtual ~ASTnode() {}
   virtual Value *codegen() = 0;
   virtual std::string to_string() const {return "";};
-  virtual std::string getName() const {return "";};
   virtual TOKEN getTok() const {return {};};
+  //semantic analysis - resolves names and types, and wraps operands in implicit casts. Returns false once an error has been reported
+  virtual bool checkSemantics() {return true;};
+  //cost of evaluating this expression unconditionally, or -1 if it has side effects or may trap (calls, assignments, division)
+  virtual int getSpeculationCost() const {return -1;};
+  //constant folding - returns a simpler node to replace this one with, or nullptr to keep it (children are folded in place)
+  virtual unique_ptr<ASTnode> foldConstants() {return nullptr;};
+  //value of the expression if it only depends on literals (after checkSemantics() has run)
+  virtual bool getConstantValue(ConstantValue &val) const {return false;};
+  //writes the fields of this node and its children to the AST cache (the kind and type are written by ASTWriter)
+  virtual void serialize(ASTWriter &W) const = 0;
+  //moves the children of this node into children, for releaseChildren()
+  virtual void takeChildren(vector<unique_ptr<ASTnode>> &children) {};
+};
+
+thread_local unsigned long ASTnode::NodesCreated[ASTnode::NumKinds] = {};
+
+//names of the node classes, as printed in the AST
+static const char *ASTnodeKindNames[ASTnode::NumKinds] = {
+  "IntegerLiteral", "FloatLiteral", "BoolLit", "VarDecl", "VarRef", "UnaryExpr", "BinaryExpr",
+  "FunctionCall", "ImplicitCast", "IfExpr", "WhileExpr", "ReturnStmt"
 };
 
+//work stack of the releaseNodes() call running on this thread, if any
+static thread_local vector<unique_ptr<ASTnode>> *ReleaseStack = nullptr;
+
+//frees the nodes in work and everything below them, using work as an explicit stack: while this runs, the nodes being
+//destroyed push their children onto it rather than destroying them, so deeply nested trees do not recurse
+static void releaseNodes(vector<unique_ptr<ASTnode>> &work)
+{
+  vector<unique_ptr<ASTnode>> *outer = ReleaseStack;
+  ReleaseStack = &work;
+  while(!work.empty())
+  {
+    unique_ptr<ASTnode> node = std::move(work.back());
+    work.pop_back();
+    node.reset();
+  }
+  ReleaseStack = outer;
+}
+
+//called by the destructors of nodes with children, which hands the children to the releaseNodes() loop
+static void releaseChildren(ASTnode *node)
+{
+  if(ReleaseStack)
+    return node->takeChildren(*ReleaseStack);
+  vector<unique_ptr<ASTnode>> work;
+  node->takeChildren(work);
+  releaseNodes(work);
+}
+
 /// IntASTnode - Class for integer literals like 1, 2, 10,
 class IntASTnode : public ASTnode {
   int Val;
@@ -483,8 +816,15 @@ class IntASTnode : public ASTnode {
   std::string Name;
 
 public:
-  IntASTnode(TOKEN tok, int val) : Val(val), Tok(tok) {}
+  IntASTnode(TOKEN tok, int val) : ASTnode(IntKind), Val(val), Tok(tok) {ExprType = INT_TYPE;}
+  static bool classof(const ASTnode *N) { return N->getKind() == IntKind; }
   virtual Value *codegen() override;
+  virtual void serialize(ASTWriter &W) const override;
+  virtual int getSpeculationCost() const override {return 0;};
+  virtual bool getConstantValue(ConstantValue &val) const override {
+    val = {INT_TYPE, Val, 0.0f};
+    return true;
+  };
   virtual TOKEN getTok() const override{
     return Tok;
   }
@@ -505,8 +845,15 @@ class FloatASTnode : public ASTnode {
   std::string Name;
 
 public:
-  FloatASTnode(TOKEN tok, float val) : Val(val), Tok(tok) {}
+  FloatASTnode(TOKEN tok, float val) : ASTnode(FloatKind), Val(val), Tok(tok) {ExprType = FLOAT_TYPE;}
+  static bool classof(const ASTnode *N) { return N->getKind() == FloatKind; }
   virtual Value *codegen() override;
+  virtual void serialize(ASTWriter &W) const override;
+  virtual int getSpeculationCost() const override {return 0;};
+  virtual bool getConstantValue(ConstantValue &val) const override {
+    val = {FLOAT_TYPE, 0, Val};
+    return true;
+  };
   virtual TOKEN getTok() const override{
     return Tok;
   }
@@ -525,8 +872,15 @@ class BoolASTnode : public ASTnode {
   std::string Name;
 
 public:
-  BoolASTnode(TOKEN tok, bool val) : Val(val), Tok(tok) {}
+  BoolASTnode(TOKEN tok, bool val) : ASTnode(BoolKind), Val(val), Tok(tok) {ExprType = BOOL_TYPE;}
+  static bool classof(const ASTnode *N) { return N->getKind() == BoolKind; }
   virtual Value *codegen() override;
+  virtual void serialize(ASTWriter &W) const override;
+  virtual int getSpeculationCost() const override {return 0;};
+  virtual bool getConstantValue(ConstantValue &val) const override {
+    val = {BOOL_TYPE, int(Val), 0.0f};
+    return true;
+  };
   virtual TOKEN getTok() const override{
     return Tok;
   }
@@ -545,9 +899,11 @@ class VariableASTnode : public ASTnode{
   TOKEN Tok;
   string Val;
   string Type;
+  AllocaInst *Alloca = nullptr; //stack slot of the variable, set by codegen()
 
   public:
-  VariableASTnode(TOKEN tok, string type, string val) : Type(type), Val(val), Tok(tok) {}
+  VariableASTnode(TOKEN tok, string type, string val) : ASTnode(VariableKind), Type(type), Val(val), Tok(tok) {}
+  static bool classof(const ASTnode *N) { return N->getKind() == VariableKind; }
   string getVal()
   {
     return Val;
@@ -556,7 +912,21 @@ class VariableASTnode : public ASTnode{
   {
     return Type;
   }
+  MiniCType getVarType() const
+  {
+    return getMiniCType(Type);
+  }
+  AllocaInst *getAlloca() const
+  {
+    return Alloca;
+  }
+  void setAlloca(AllocaInst *alloca)
+  {
+    Alloca = alloca;
+  }
   virtual Value *codegen() override;
+  virtual void serialize(ASTWriter &W) const override;
+  virtual bool checkSemantics() override;
   virtual TOKEN getTok() const override{
     return Tok;
   }
@@ -572,14 +942,22 @@ class VariableASTnode : public ASTnode{
 class VariableReferenceASTnode : public ASTnode{
   TOKEN Tok;
   string Name;
+  VariableASTnode *Decl = nullptr; //local variable or parameter the name resolves to, nullptr for global variables
+  bool IsLValue = false; //set for the LHS of an assignment, which needs the address of the variable rather than its value
 
   public:
-  VariableReferenceASTnode(TOKEN tok, string name) : Name(name), Tok(tok) {}
+  VariableReferenceASTnode(TOKEN tok, string name) : ASTnode(VariableReferenceKind), Name(name), Tok(tok) {}
+  static bool classof(const ASTnode *N) { return N->getKind() == VariableReferenceKind; }
   virtual Value *codegen() override;
+  virtual void serialize(ASTWriter &W) const override;
+  virtual bool checkSemantics() override;
+  virtual int getSpeculationCost() const override {return 1;}; //a single load
   virtual TOKEN getTok() const override{
     return Tok;
   }
-  std::string getName() const override{ return Name; }
+  std::string getName() const { return Name; }
+  void setLValue() { IsLValue = true; }
+  void setDecl(VariableASTnode *decl) { Decl = decl; }
   virtual std::string to_string() const override {
   //return a string representation of this AST node
     string final = "VarRef: " + Name;
@@ -596,9 +974,25 @@ class UnaryExprASTnode : public ASTnode {
 
 public:
   UnaryExprASTnode(string Opcode, std::unique_ptr<ASTnode> Operand, TOKEN tok)
-      : Opcode(Opcode), Operand(std::move(Operand)), Tok(tok) {}
+      : ASTnode(UnaryExprKind), Opcode(Opcode), Operand(std::move(Operand)), Tok(tok) {}
+  static bool classof(const ASTnode *N) { return N->getKind() == UnaryExprKind; }
+  virtual ~UnaryExprASTnode() { releaseChildren(this); }
+  virtual void takeChildren(vector<unique_ptr<ASTnode>> &children) override {
+    children.push_back(std::move(Operand));
+  };
 
   virtual Value *codegen() override;
+  virtual void serialize(ASTWriter &W) const override;
+  virtual bool checkSemantics() override;
+  virtual unique_ptr<ASTnode> foldConstants() override;
+  virtual bool getConstantValue(ConstantValue &val) const override;
+  virtual int getSpeculationCost() const override {
+    int cost = Operand->getSpeculationCost();
+    return cost < 0 ? -1 : cost + 1;
+  };
+  virtual TOKEN getTok() const override{
+    return Tok;
+  }
   virtual std::string to_string() const override {
   //return a string representation of this AST node
     string final =  "UnaryExpr: " + Opcode  + "\n" + addIndent() + "--> " + Operand->to_string();
@@ -616,9 +1010,30 @@ class BinaryExprASTnode : public ASTnode {
 public:
   BinaryExprASTnode(string Opcode, std::unique_ptr<ASTnode> LHS,
                 std::unique_ptr<ASTnode> RHS, TOKEN tok)
-      : Opcode(Opcode), LHS(std::move(LHS)), RHS(std::move(RHS)), Tok(tok) {}
+      : ASTnode(BinaryExprKind), Opcode(Opcode), LHS(std::move(LHS)), RHS(std::move(RHS)), Tok(tok) {}
+  static bool classof(const ASTnode *N) { return N->getKind() == BinaryExprKind; }
+  virtual ~BinaryExprASTnode() { releaseChildren(this); }
+  virtual void takeChildren(vector<unique_ptr<ASTnode>> &children) override {
+    children.push_back(std::move(LHS));
+    children.push_back(std::move(RHS));
+  };
 
+  Value *codegenShortCircuit();
   virtual Value *codegen() override;
+  virtual void serialize(ASTWriter &W) const override;
+  virtual bool checkSemantics() override;
+  virtual unique_ptr<ASTnode> foldConstants() override;
+  virtual bool getConstantValue(ConstantValue &val) const override;
+  virtual int getSpeculationCost() const override {
+    if(Opcode == "=" | Opcode == "/" | Opcode == "%")
+      return -1;
+    int lhsCost = LHS->getSpeculationCost();
+    int rhsCost = RHS->getSpeculationCost();
+    return (lhsCost < 0 | rhsCost < 0) ? -1 : lhsCost + rhsCost + 1;
+  };
+  virtual TOKEN getTok() const override{
+    return Tok;
+  }
   virtual std::string to_string() const override {
   //return a string representation of this AST node
     string final = "BinaryExpr: " + Opcode + "\n" + addIndent() + "--> " + LHS->to_string() + "\n" + addIndent() + "--> " + RHS->to_string();
@@ -636,9 +1051,21 @@ class FuncCallASTnode : public ASTnode {
 public:
   FuncCallASTnode(const std::string &Callee,
               std::vector<std::unique_ptr<ASTnode>> Args, TOKEN tok)
-      : Callee(Callee), Args(std::move(Args)), Tok(tok) {}
+      : ASTnode(FuncCallKind), Callee(Callee), Args(std::move(Args)), Tok(tok) {}
+  static bool classof(const ASTnode *N) { return N->getKind() == FuncCallKind; }
+  virtual ~FuncCallASTnode() { releaseChildren(this); }
+  virtual void takeChildren(vector<unique_ptr<ASTnode>> &children) override {
+    for(auto &arg : Args)
+      children.push_back(std::move(arg));
+  };
 
   virtual Value *codegen() override;
+  virtual void serialize(ASTWriter &W) const override;
+  virtual bool checkSemantics() override;
+  virtual unique_ptr<ASTnode> foldConstants() override;
+  virtual TOKEN getTok() const override{
+    return Tok;
+  }
   virtual std::string to_string() const override {
   //return a string representation of this AST node
     string args = "";
@@ -652,6 +1079,36 @@ public:
   };
 };
 
+/// ImplicitCastASTnode - Widening conversion (bool to int, bool to float or int to float) inserted by the semantic analysis pass
+class ImplicitCastASTnode : public ASTnode {
+  std::unique_ptr<ASTnode> Operand;
+
+public:
+  ImplicitCastASTnode(std::unique_ptr<ASTnode> operand, MiniCType type)
+      : ASTnode(ImplicitCastKind), Operand(std::move(operand)) {ExprType = type;}
+  static bool classof(const ASTnode *N) { return N->getKind() == ImplicitCastKind; }
+  virtual ~ImplicitCastASTnode() { releaseChildren(this); }
+  virtual void takeChildren(vector<unique_ptr<ASTnode>> &children) override {
+    children.push_back(std::move(Operand));
+  };
+
+  virtual Value *codegen() override;
+  virtual void serialize(ASTWriter &W) const override;
+  virtual unique_ptr<ASTnode> foldConstants() override;
+  virtual bool getConstantValue(ConstantValue &val) const override;
+  virtual int getSpeculationCost() const override {
+    int cost = Operand->getSpeculationCost();
+    return cost < 0 ? -1 : cost + 1;
+  };
+  virtual TOKEN getTok() const override{
+    return Operand->getTok();
+  }
+  virtual std::string to_string() const override {
+  //casts are not part of the source, so only the operand is printed
+    return Operand->to_string();
+  };
+};
+
 /// IfExprASTnode - Expression class for if statement
 class IfExprASTnode : public ASTnode {
   std::unique_ptr<ASTnode> Cond;
@@ -660,9 +1117,22 @@ class IfExprASTnode : public ASTnode {
 public:
   IfExprASTnode(std::unique_ptr<ASTnode> Cond, std::vector<std::unique_ptr<ASTnode>> Then,
             std::vector<std::unique_ptr<ASTnode>> Else)
-      : Cond(std::move(Cond)), Then(std::move(Then)), Else(std::move(Else)) {}
+      : ASTnode(IfExprKind), Cond(std::move(Cond)), Then(std::move(Then)), Else(std::move(Else)) {}
+  static bool classof(const ASTnode *N) { return N->getKind() == IfExprKind; }
+  virtual ~IfExprASTnode() { releaseChildren(this); }
+  virtual void takeChildren(vector<unique_ptr<ASTnode>> &children) override {
+    children.push_back(std::move(Cond));
+    for(auto &stmt : Then)
+      children.push_back(std::move(stmt));
+    for(auto &stmt : Else)
+      children.push_back(std::move(stmt));
+  };
 
   virtual Value *codegen() override;
+  virtual void serialize(ASTWriter &W) const override;
+  virtual bool checkSemantics() override;
+  virtual unique_ptr<ASTnode> foldConstants() override;
+  bool alwaysReturns() const;
   virtual std::string to_string() const override {
   //return a string representation of this AST node
    string ThenStr = "";
@@ -702,9 +1172,19 @@ class WhileExprASTnode : public ASTnode {
 
 public:
   WhileExprASTnode(std::unique_ptr<ASTnode> cond, std::vector<std::unique_ptr<ASTnode>> then)
-      : Cond(std::move(cond)), Then(std::move(then)) {}
+      : ASTnode(WhileExprKind), Cond(std::move(cond)), Then(std::move(then)) {}
+  static bool classof(const ASTnode *N) { return N->getKind() == WhileExprKind; }
+  virtual ~WhileExprASTnode() { releaseChildren(this); }
+  virtual void takeChildren(vector<unique_ptr<ASTnode>> &children) override {
+    children.push_back(std::move(Cond));
+    for(auto &stmt : Then)
+      children.push_back(std::move(stmt));
+  };
 
   virtual Value *codegen() override;
+  virtual void serialize(ASTWriter &W) const override;
+  virtual bool checkSemantics() override;
+  virtual unique_ptr<ASTnode> foldConstants() override;
   virtual std::string to_string() const override {
   //return a string representation of this AST node
     string ThenStr = "";
@@ -728,9 +1208,17 @@ class ReturnExprASTnode : public ASTnode {
 
 public:
   ReturnExprASTnode(std::unique_ptr<ASTnode> returnExpr, string funcReturnType, TOKEN tok)
-      : ReturnExpr(std::move(returnExpr)), FuncReturnType(funcReturnType), Tok(tok) {}
+      : ASTnode(ReturnExprKind), ReturnExpr(std::move(returnExpr)), FuncReturnType(funcReturnType), Tok(tok) {}
+  static bool classof(const ASTnode *N) { return N->getKind() == ReturnExprKind; }
+  virtual ~ReturnExprASTnode() { releaseChildren(this); }
+  virtual void takeChildren(vector<unique_ptr<ASTnode>> &children) override {
+    children.push_back(std::move(ReturnExpr));
+  };
 
   virtual Value *codegen() override;
+  virtual void serialize(ASTWriter &W) const override;
+  virtual bool checkSemantics() override;
+  virtual unique_ptr<ASTnode> foldConstants() override;
   virtual TOKEN getTok() const override{
     return Tok;
   }
@@ -752,7 +1240,11 @@ class TopLevelASTnode {
 public:
   virtual ~TopLevelASTnode() {}
   virtual Value *codegen() = 0;
+  virtual bool checkSemantics() {return true;};
+  virtual void foldConstants() {};
+  virtual bool hasBody() const {return false;}; //function definitions are generated by the workers of the parallel code generator
   virtual std::string to_string() const {return "";};
+  virtual void serialize(ASTWriter &W) const = 0;
 };
 
 //GlobalVariableAST - This class represents global variable declarations
@@ -771,7 +1263,14 @@ class GlobalVariableAST : public TopLevelASTnode {
   {
     return Ty;
   }
+  MiniCType getVarType() const
+  {
+    return getMiniCType(Ty);
+  }
   virtual Value *codegen() override;
+  GlobalVariable *declare(); //external declaration, for modules that use the variable without defining it
+  virtual bool checkSemantics() override;
+  virtual void serialize(ASTWriter &W) const override;
   virtual std::string to_string() const override {
   //return a string representation of this AST node
     string final =  "GlobalVarDecl: " + Ty + " " + Val; 
@@ -783,7 +1282,7 @@ class GlobalVariableAST : public TopLevelASTnode {
 /// PrototypeAST - This class represents the "prototype" for a function, capturing its name, and its argument names
 class PrototypeAST : public TopLevelASTnode {
   std::string Name;
-  std::vector<unique_ptr<VariableASTnode>> Args;
+  std::vector<unique_ptr<VariableASTnode>> Args; //a `void` parameter list is stored as a single argument of type `void`
 
 public:
   PrototypeAST(std::string &Name, std::vector<unique_ptr<VariableASTnode>> Args)
@@ -796,7 +1295,45 @@ public:
     return Args.at(index)->getVal();
   }
 
+  string getArgType(int index)
+  {
+    return Args.at(index)->getType();
+  }
+
+  VariableASTnode *getArg(int index) const
+  {
+    return Args.at(index).get();
+  }
+
+  int getNumArgs() const
+  {
+    return Args.size();
+  }
+
+  //number of parameters the function is called with (without the `void` in `foo(void)`)
+  int getNumParams() const
+  {
+    return (Args.size() == 1 && Args[0]->getVarType() == VOID_TYPE) ? 0 : Args.size();
+  }
+
+  //return type, from a name such as "int foo" or "extern int foo"
+  string getReturnType() const
+  {
+    string name = Name;
+    if(name.rfind("extern ", 0) == 0)
+      name = name.substr(7);
+    return name.substr(0, name.find(" "));
+  }
+
+  //function name without its return type
+  string getFunctionName() const
+  {
+    return Name.substr(Name.rfind(" ") + 1);
+  }
+
   virtual Function *codegen() override;
+  virtual bool checkSemantics() override;
+  virtual void serialize(ASTWriter &W) const override;
 
   virtual std::string to_string() const override {
   //return a string representation of this AST node
@@ -815,13 +1352,44 @@ public:
 class FunctionAST : public TopLevelASTnode {
   std::unique_ptr<PrototypeAST> Proto;
   std::vector<std::unique_ptr<ASTnode>> Body;
+  string TokenDigest; //SHA1 of the function's tokens, only recorded for --incremental
+  std::set<string> Identifiers; //every identifier in the function's tokens
+  std::vector<TOKEN> BodyTokens; //with --lazy-bodies and -fparallel-parse, the body is kept as its tokens until it is parsed
+  size_t TopLevelDiagnosticsEnd = 0; //end of the top-level diagnostics reported before the body was skimmed
 
 public:
   FunctionAST(std::unique_ptr<PrototypeAST> Proto, //can have no prototypes (just block of expressions e.g. global variables)
               std::vector<std::unique_ptr<ASTnode>> Body) //Body can contain multiple expressions
       : Proto(std::move(Proto)), Body(std::move(Body)) {}
+        virtual ~FunctionAST() { releaseNodes(Body); }
 
         virtual Function *codegen() override;
+        virtual bool checkSemantics() override;
+        virtual void foldConstants() override;
+        virtual bool hasBody() const override {return true;};
+        virtual void serialize(ASTWriter &W) const override;
+
+        void setTokens(string digest, std::set<string> identifiers)
+        {
+          TokenDigest = std::move(digest);
+          Identifiers = std::move(identifiers);
+        }
+        const string &getTokenDigest() const {return TokenDigest;}
+        const std::set<string> &getIdentifiers() const {return Identifiers;}
+        const PrototypeAST &getProto() const {return *Proto;}
+        void releaseBody() {releaseNodes(Body); std::vector<std::unique_ptr<ASTnode>>().swap(Body);} //--stream: the body is not needed once its code has been generated
+        void setBodyTokens(std::vector<TOKEN> tokens, size_t diagnosticsEnd)
+        {
+          BodyTokens = std::move(tokens);
+          TopLevelDiagnosticsEnd = diagnosticsEnd;
+        }
+        const std::vector<TOKEN> &getBodyTokens() const {return BodyTokens;}
+        size_t getTopLevelDiagnosticsEnd() const {return TopLevelDiagnosticsEnd;}
+        void setBody(std::vector<std::unique_ptr<ASTnode>> body) //the body parsed from BodyTokens
+        {
+          Body = std::move(body);
+          std::vector<TOKEN>().swap(BodyTokens);
+        }
 
     virtual std::string to_string() const override{
   //return a string representation of this AST node
@@ -853,21 +1421,50 @@ static vector<unique_ptr<TopLevelASTnode>> root;
 //null value for TOKEN variables
 TOKEN nullToken = {};
 
-static string prototypeName = ""; //stores prototype name during parsing
-static unique_ptr<VariableASTnode> argument = std::make_unique<VariableASTnode>(CurTok,"",""); //stores a function argument/parameter
-static unique_ptr<GlobalVariableAST> globalVar = std::make_unique<GlobalVariableAST>(CurTok,"",""); //stores a global variable
-static string vartype = ""; //string that specifies type of variable, this is added to the VariableASTnode
-static string functiontype = ""; //string that specifies type of function, this is added to the FunctionASTnode
-static vector<unique_ptr<VariableASTnode>> argumentList = {}; //stores list of arguments of a function
-static vector<unique_ptr<ASTnode>> body = {}; //stores contents of a function body as a vector of ASTnodes
-static TOKEN functionIdent = nullToken; //stores identifier of a function
-static TOKEN variableIdent = nullToken; //storesd identifier of a variable
-
-static deque<pair<string,unique_ptr<ASTnode>>> stmtList; //temporary queue of named AST nodes used to process control flow statements in processStmt()
+//the parser's data stores are per thread, as with -fparallel-parse function bodies are parsed on worker threads
+static thread_local string prototypeName = ""; //stores prototype name during parsing
+static thread_local unique_ptr<VariableASTnode> argument = nullptr; //stores a function argument/parameter
+static thread_local unique_ptr<GlobalVariableAST> globalVar = nullptr; //stores a global variable
+static thread_local string vartype = ""; //string that specifies type of variable, this is added to the VariableASTnode
+static thread_local string functiontype = ""; //string that specifies type of function, this is added to the FunctionASTnode
+static thread_local vector<unique_ptr<VariableASTnode>> argumentList = {}; //stores list of arguments of a function
+static thread_local vector<unique_ptr<ASTnode>> body = {}; //stores contents of a function body as a vector of ASTnodes
+static thread_local TOKEN functionIdent = nullToken; //stores identifier of a function
+static thread_local TOKEN variableIdent = nullToken; //storesd identifier of a variable
+
+static thread_local vector<unique_ptr<ASTnode>> *stmtBlock = &body; //statements are added to this block as they are parsed: the function body, or the innermost if, else or while block
+
+static thread_local vector<TOKEN> expression = {}; //these vector of token are used to parse the expression and create the correct ASTnodes
+
+static thread_local bool errorReported = false; //used to make sure duplicate syntax error message are not being printed 
+static thread_local int SyntaxErrors = 0; //syntax errors the parser has recovered from
+static int ErrorLimit = 20; //set by -ferror-limit=N: parsing stops after N syntax errors, 0 for no limit
+static thread_local bool ErrorLimitReached = false;
+static thread_local raw_ostream *ParseDiagnostics = nullptr; //on the parser's worker threads, diagnostics are collected here and printed in source order
+static thread_local CompileStats *ParseStats = &Stats; //where the parser's counters are kept
+static string ReportedWarnings; //warnings of the compile, which are stored in the AST cache (those of the parser and semantic analysis) and the --cache-dir entry, and printed again on a hit
+
+//stream for syntax errors and the parser's warnings
+static raw_ostream &parseErrs()
+{
+  return ParseDiagnostics ? *ParseDiagnostics : errs();
+}
 
-static vector<TOKEN> expression = {}; //these vector of token are used to parse the expression and create the correct ASTnodes
+//prints a warning of the parser, semantic analysis or constant folding. Warnings collected in ParseDiagnostics are recorded once they are printed
+static void reportWarning(raw_ostream &OS, const Twine &warning)
+{
+  OS<<warning;
+  if(!ParseDiagnostics)
+    ReportedWarnings += warning.str();
+}
 
-static bool errorReported = false; //used to make sure duplicate syntax error message are not being printed 
+static bool Streaming = false; //set by --stream: each top-level declaration is compiled as soon as it has been parsed
+static bool LazyBodies = false; //set by --lazy-bodies: function bodies are skimmed, and only parsed if they are reachable from LazyRoots
+static std::set<string> LazyRoots;
+static bool ParallelParse = false; //set by -fparallel-parse: function bodies are skimmed, and parsed on the -j threads once the file has been read
+static vector<TOKEN> skimmedBody = {}; //tokens of the function body skimmed for --lazy-bodies or -fparallel-parse, from "{" to "}"
+static string TopLevelDiagnostics; //when bodies are skimmed, the diagnostics outside of them, printed in source order with those of the bodies
+static bool streamTopLevelNodes(); //compiles the declarations in root that have not been compiled yet
 
 ///Following functions are used to correctly flush these data stores after use for one AST node.
 
@@ -878,12 +1475,12 @@ void resetPrototypeName()
 
 void resetArgument()
 {
-  argument = std::make_unique<VariableASTnode>(nullToken,"","");
+  argument = nullptr;
 }
 
 void resetGlobalVar()
 {
-  globalVar = std::make_unique<GlobalVariableAST>(nullToken,"","");
+  globalVar = nullptr;
 }
 
 void resetVartype()
@@ -906,11 +1503,6 @@ void resetBody()
   body.clear();
 }
 
-void resetStmtList()
-{
-  stmtList.clear();
-}
-
 void resetFunctionIdent()
 {
   functionIdent = nullToken;
@@ -926,6 +1518,88 @@ void resetExpression()
   expression.clear();
 }
 
+///Panic-mode error recovery: after a syntax error the parser skips to a synchronising token and carries on,
+///so that one run reports every syntax error in the file rather than just the first.
+
+//counts the syntax error that has just been reported and allows the next one to be reported.
+//Returns false when parsing cannot carry on: at the end of the file, or once the error limit is reached.
+static bool recoverFromError()
+{
+  if(CurTok.type == EOF_TOK || ErrorLimitReached)
+    return false;
+
+  SyntaxErrors++;
+  if(ErrorLimit != 0 && SyntaxErrors >= ErrorLimit && !ParseDiagnostics) //the limit applies to the errors of worker threads once they are printed
+  {
+    errs()<<"Too many syntax errors, stopping now (-ferror-limit="<<ErrorLimit<<").\n";
+    ErrorLimitReached = true;
+    return false;
+  }
+
+  errorReported = false;
+  resetExpression();
+  resetVartype();
+  resetVariableToken();
+  return true;
+}
+
+//skips the rest of a statement or local declaration with a syntax error: up to and including the next ";" or
+//nested block (and the else block that follows it), or up to the "}" that closes the enclosing block, which is
+//in FOLLOW(stmt_list)
+static void skipStatement()
+{
+  int depth = 0;
+  while(CurTok.type != EOF_TOK)
+  {
+    if(CurTok.type == RBRA)
+    {
+      if(depth == 0)
+        return;
+      if(--depth == 0)
+      {
+        getNextToken();
+        if(CurTok.type != ELSE)
+          return;
+        continue;
+      }
+    }
+    else if(CurTok.type == LBRA)
+      depth++;
+    else if(CurTok.type == SC && depth == 0)
+    {
+      getNextToken();
+      return;
+    }
+    getNextToken();
+  }
+}
+
+//skips the rest of a top-level declaration with a syntax error, up to the next "extern" or type outside of any
+//block, which starts the next declaration, and clears whatever the parser had gathered for it
+static void skipDeclaration()
+{
+  int depth = 0;
+  while(CurTok.type != EOF_TOK)
+  {
+    if(depth == 0 && (CurTok.type == EXTERN || CurTok.type == VOID_TOK || CurTok.type == INT_TOK || CurTok.type == FLOAT_TOK || CurTok.type == BOOL_TOK))
+      break;
+    if(CurTok.type == LBRA)
+      depth++;
+    else if(CurTok.type == RBRA && depth > 0)
+      depth--;
+    getNextToken();
+  }
+
+  resetPrototypeName();
+  resetArgument();
+  resetGlobalVar();
+  resetFunctiontype();
+  resetArgumentList();
+  resetBody();
+  resetFunctionIdent();
+  skimmedBody.clear();
+}
+
 //===----------------------------------------------------------------------===//
 // Helper functions to use during parsing and AST node generation
 //===----------------------------------------------------------------------===//
@@ -965,120 +1639,15 @@ void addFunctionAST()
   resetFunctiontype();
   unique_ptr<FunctionAST> Func = std::make_unique<FunctionAST>(std::move(Proto),std::move(body)); //create FunctionAST node, containing PrototypeAST node, created earlier, and vector of AST nodes, body.
   resetBody();
+  if(LazyBodies || ParallelParse)
+    Func->setBodyTokens(std::move(skimmedBody), TopLevelDiagnostics.size());
+  skimmedBody.clear();
+  if(RecordTokens) //the tokens from the return type to the closing brace, leaving out the lookahead after it
+    Func->setTokens(toHex(SHA1::hash(arrayRefFromStringRef(StringRef(RecordedTokens).take_front(RecordedTokensEnd))), true),
+                    std::move(RecordedIdentifiers));
   root.push_back(std::move(Func)); //add FunctionAST to root
 }
 
-static std::pair<std::string, std::unique_ptr<ASTnode>> curr; //used in function below to store current statement token to process
-
-//Function used to process all control flow statements and contained expressions, and create their correct AST nodes
-unique_ptr<ASTnode> processStmtList()
-{
-  if(stmtList.size() > 0) //only pop if size is greater than one to avoid seg faults.
-  {
-    curr = std::move(stmtList.front());
-    stmtList.pop_front();
-  }
-  else
-  {
-    return nullptr;
-  }
-
-  if(curr.first == "vardecl") //if a variable declaration is detected, return its AST node
-  {
-    return std::move(curr.second);
-  }
-  else if(curr.first == "expr") //return expression AST node
-  {
-    return std::move(curr.second);
-  }
-  else if(curr.first == "while") //process while statement and block
-  {
-    unique_ptr<ASTnode> cond = processStmtList(); //process the condition statement and store it here
-    vector<unique_ptr<ASTnode>> then = {};
-    while(curr.first != "end_while") //if 'end_while' flag is not detected, keep on adding following ASTnodes in queue to the Then block of while
-    {
-      unique_ptr<ASTnode> node = std::move(processStmtList());
-      if(node != nullptr)
-        then.push_back(std::move(node));
-    }
-    if(curr.first == "end_while") //don't add this flag to any blocks - signifies end of a block
-    {
-      curr.first = ""; //acknowledge end of while
-      return std::move(make_unique<WhileExprASTnode>(std::move(cond),std::move(then))); //return created while block
-    }
-    else
-    {
-      return nullptr;
-    }
-    
-  }
-  else if(curr.first == "if") //process if statement and block
-  {
-    unique_ptr<ASTnode> cond = processStmtList(); //process the condition statement and store it here
-    vector<unique_ptr<ASTnode>> Then = {};
-    vector<unique_ptr<ASTnode>> Else = {};
-
-    while((curr.first != "end_if")) //keep on adding following ASTnodes to the Then block until the "end_if" flag is detected
-    {
-      unique_ptr<ASTnode> node = std::move(processStmtList());
-      if(node != nullptr)
-        Then.push_back(std::move(node));
-    }
-
-    if(curr.first == "end_if") //skip this flag
-    {
-      curr = std::move(stmtList.front());
-      stmtList.pop_front();
-    }
-
-    if(curr.first == "no_else") //this flag means that no Else block exists, so return the If ASTnode with a filled Then block, and empty Else block
-    {
-      return std::move(make_unique<IfExprASTnode>(std::move(cond),std::move(Then),std::move(Else)));
-    }
-    else if(curr.first == "else") //this flag means that an Else block exists
-    {
-      while(curr.first != "end_else") //keep on adding following ASTnodes to the Else block until the "end_else" flag is detected
-      {
-        unique_ptr<ASTnode> node = std::move(processStmtList());
-        if(node != nullptr)
-          Else.push_back(std::move(node));
-      }
-    } 
-
-    if(curr.first == "end_else") //flag signified end of Else block
-    {
-      curr.first = ""; //acknowledge end of else
-      return std::move(make_unique<IfExprASTnode>(std::move(cond),std::move(Then),std::move(Else))); //return If ASTnode with filled Then and Else blocks
-    }
-    else
-    {
-      return nullptr;
-    }
-
-  }
-  else if(curr.first == "return") //create a returnExpr node for return statements
-  {
-    unique_ptr<ASTnode> returnExpr = processStmtList();
-    TOKEN returnTok = nullToken;
-    if(returnExpr != nullptr)
-      returnTok = returnExpr->getTok();
-    unique_ptr<ReturnExprASTnode> returnNode = make_unique<ReturnExprASTnode>(std::move(returnExpr),functiontype, returnTok);
-    return std::move(returnNode);
-  }
-  else return std::move(nullptr); //if value in stmt_list is unrecognisable, return nullptr
-} 
-
-//Function which uses the processStmtList() to add control flow AST nodes to the body of parent function
-void addToBody()
-{
-  while(stmtList.size() != 0)
-  {
-    unique_ptr<ASTnode> ptr = std::move(processStmtList());
-    if(ptr != nullptr)
-      body.push_back(std::move(ptr));
-  }
-}
-
 //Used to determine precedence of input operator
 int getPrecedence(string op)
 {
@@ -1100,194 +1669,150 @@ int getPrecedence(string op)
     return 110; //invalid (not an operator)
 }
 
-//This helper function is used to check if first left paranthesis is closed by the right paranthesis at the end of the expression
-bool isMatchingLastParam(vector<TOKEN> expression)
+//creates the AST node of a literal or variable reference
+static unique_ptr<ASTnode> createOperandASTnode(const TOKEN &t)
 {
-  int buf = 0;
-  for(int i = 1; i < expression.size(); i++)
+  if(t.type == INT_LIT) //for int literals
   {
-    if(expression.at(i).type == RPAR && buf == 0)
-    {
-      if(i == expression.size() - 1)
-        return true;
-      else
-        return false;
+    int val;
+    try{ //make sure that the string conversion results in a value that is within the valid integer range
+       val = stoi(t.lexeme);
     }
-    else if(expression.at(i).type == RPAR && buf > 0)
+    catch(std::out_of_range) //otherwise, set the value to 0 to avoid undefined values
     {
-      buf--;
+      reportWarning(parseErrs(), "Warning: Value " + t.lexeme + " out of range for int type. Setting it to 0\n");
+      val = stoi("0");
     }
-    else if(expression.at(i).type == LPAR)
+    return make_unique<IntASTnode>(t,val); //return IntAST node
+  }
+  else if(t.type == FLOAT_LIT) //for float literals
+  {
+    float val;
+    try{ //make sure that the string conversion results in a value that is within the valid float range
+       val = stof(t.lexeme);
+    }
+    catch(std::out_of_range) //otherwise, set the value to 0.0 to avoid undefined values
     {
-      buf++;
-    } 
+      reportWarning(parseErrs(), "Warning: Value " + t.lexeme + " out of range for float type. Setting it to 0.0\n");
+      val = stof("0.0");
+    }
+    return make_unique<FloatASTnode>(t,val);
   }
-  return false;
+  else if(t.type == BOOL_LIT) //for boolean literals, true or false
+    return make_unique<BoolASTnode>(t, t.lexeme == "true");
+  else if(t.type == IDENT)
+    return make_unique<VariableReferenceASTnode>(t,t.lexeme);
+  return nullptr;
 }
 
-//Essential helper function used to parse expressions and create correct AST nodes
-unique_ptr<ASTnode> createExprASTnode(vector<TOKEN> expression)
+/// ExprFrame - an entry of the operator stack of createExprASTnode(): an operator waiting for its operands, an open
+/// parenthesis, or a function call whose arguments start at operand ArgsBegin
+struct ExprFrame {
+  enum FrameKind {BINARY, UNARY, PAREN, CALL} Kind;
+  TOKEN Tok; //the operator, or the function name of a call
+  size_t ArgsBegin;
+};
+
+//Builds the AST of an expression from its tokens, which the parser has already checked against the grammar. This is
+//operator precedence parsing with explicit operand and operator stacks, so it takes linear time and deeply nested
+//expressions do not recurse. Unary - and ! bind tighter than any binary operator, binary operators are left
+//associative except for the right associative `=`, and arguments of calls may contain calls and parentheses.
+unique_ptr<ASTnode> createExprASTnode(const vector<TOKEN> &expression)
 {
-  if(expression.size() == 1) //literals
-  {
-    TOKEN t = expression.at(0);
-    if(t.type == INT_LIT) //for int literals
+  vector<unique_ptr<ASTnode>> operands;
+  vector<ExprFrame> operators;
+
+  //pops the operator on top of the stack, replacing its operands with the node it builds
+  auto reduce = [&]() {
+    ExprFrame frame = std::move(operators.back());
+    operators.pop_back();
+    unique_ptr<ASTnode> rhs = std::move(operands.back());
+    operands.pop_back();
+    if(frame.Kind == ExprFrame::UNARY)
+      operands.push_back(make_unique<UnaryExprASTnode>(frame.Tok.lexeme, std::move(rhs), frame.Tok));
+    else
     {
-      int val;
-      try{ //make sure that the string conversion results in a value that is within the valid integer range
-         val = stoi(t.lexeme);
-      }
-      catch(std::out_of_range) //otherwise, set the value to 0 to avoid undefined values
-      {
-        errs()<<"Warning: Value "<<t.lexeme<<" out of range for int type. Setting it to 0\n";
-        val = stoi("0");
-      }
-      
-      return std::move(make_unique<IntASTnode>(t,val)); //return IntAST node
+      unique_ptr<ASTnode> lhs = std::move(operands.back());
+      operands.pop_back();
+      operands.push_back(make_unique<BinaryExprASTnode>(frame.Tok.lexeme, std::move(lhs), std::move(rhs), frame.Tok));
     }
-    else if(t.type == FLOAT_LIT) //for int literals
-    {
-      float val;
-      try{ //make sure that the string conversion results in a value that is within the valid float range
-         val = stof(t.lexeme);
-      }
-      catch(std::out_of_range) //otherwise, set the value to 0.0 to avoid undefined values
-      {
-        errs()<<"Warning: Value "<<t.lexeme<<" out of range for float type. Setting it to 0.0\n";
-        val = stof("0.0");
-      }
-      return std::move(make_unique<FloatASTnode>(t,val));
-    }
-    else if(t.type == BOOL_LIT) //for boolean literals, true or false
-    {
-      if(t.lexeme == "true")
-        return make_unique<BoolASTnode>(t,true);
-      else if(t.lexeme == "false")
-        return make_unique<BoolASTnode>(t,false);
-    }
-    else if(t.type == IDENT)
-    {
-      return std::move(make_unique<VariableReferenceASTnode>(t,t.lexeme));
-    }
-    else
-    {
-      return std::move(nullptr);
-    }
-  }
-  //for unary expressions 
-  else if((expression.at(0).lexeme == "-" | expression.at(0).lexeme == "!") & (expression.at(1).lexeme == "-" | expression.at(1).lexeme == "!" | expression.at(1).lexeme == "(" | expression.size() == 2)) 
-  {
-    string opcode = expression.at(0).lexeme;
-    vector<TOKEN> operand = {}; //this can either be a single value or a long expression that needs to be parsed recursively
-    for(int i = 1; i < expression.size(); i++)
-      operand.push_back(expression.at(i));
+  };
+  //reduces the operators above the innermost open parenthesis or call
+  auto reduceGroup = [&]() {
+    while(operators.back().Kind == ExprFrame::BINARY || operators.back().Kind == ExprFrame::UNARY)
+      reduce();
+  };
 
-    return std::move(make_unique<UnaryExprASTnode>(opcode,std::move(createExprASTnode(operand)),expression.at(0))); //return UnaryExprASTnode with opcode and operand(s)
-  }
-  else if((expression.at(0).lexeme == "(") & (isMatchingLastParam(expression) == true)) //for bracketed expr from start to end e.g (a + d + (a+f)), not (a+f)+(-e+d)
+  bool expectOperand = true; //false after an operand, when a binary operator or a closing token follows
+  for(size_t i = 0; i < expression.size(); i++)
   {
-    vector<TOKEN> newExpr = {}; //remove the first and last parantheses
-    for(int i = 1; i < expression.size() - 1; i++)
+    const TOKEN &t = expression[i];
+    if(expectOperand && (t.lexeme == "-" || t.lexeme == "!"))
+      operators.push_back({ExprFrame::UNARY, t, 0});
+    else if(t.type == IDENT && i + 1 < expression.size() && expression[i + 1].type == LPAR)
     {
-      newExpr.push_back(expression.at(i)); 
-    } 
-    return std::move(createExprASTnode(newExpr)); //parse resulting expression and return it
-  }
-  else if((expression.at(0).type == IDENT) & (expression.at(1).type == LPAR)) //function call with or without arguments
-  {
-    TOKEN funcTok = expression.at(0); //save identifier token to store in ASTnode, for use in printing out errors
-
-    string callee = expression.at(0).lexeme; //get function callee name
-
-    vector<unique_ptr<ASTnode>> args = {};
-    vector<TOKEN> expr = {};
-    bool start = false;
-    if(expression.at(2).type != RPAR) //if function call has arguments
+      operators.push_back({ExprFrame::CALL, t, operands.size()});
+      i++; //the opening parenthesis of the call
+    }
+    else if(t.type == LPAR)
+      operators.push_back({ExprFrame::PAREN, t, 0});
+    else if(t.type == COMMA)
     {
-      for(int i = 2; i < expression.size(); i++) //ignoring first LPAR and last RPAR
-      {
-        if(i==2)
-          start = true;
-
-        if(i == expression.size()-1)
-        {
-          start = false;
-          args.push_back(std::move(createExprASTnode(expr))); //parse expr and add to args
-          expr.clear();
-        }
-
-        if(expression.at(i).type == COMMA)
-        {
-          args.push_back(std::move(createExprASTnode(expr))); //parse expr and add to args
-          expr.clear();
-        }
-        else
-        {
-          if(start == true)
-          {
-            expr.push_back(expression.at(i));
-          }
-        }
-      }
+      reduceGroup(); //the argument before the comma
+      expectOperand = true;
     }
-      return std::move(make_unique<FuncCallASTnode>(callee,std::move(args),funcTok)); //return FuncCallASTnode
-  }
-  else 
-  {
-    int minPrecedence = 100;
-    string op = "";
-    TOKEN opTok;
-    int index = 0;
-    bool isOp = true;
-    bool unaryEnd = true;
-    int valid = 0; //operators inside bracketed expressions are invalid so value set to 1, otherwise set to 0
-    for(int i = 0; i < expression.size(); i++)
+    else if(t.type == RPAR)
     {
-      int currPrecedence = getPrecedence(expression.at(i).lexeme);
-      if(expression.at(i).lexeme == "(") 
-      {
-        valid++; //don't parse bracket expressions here
-      }
-      if(expression.at(i).lexeme == ")")
-      {
-        valid--;
-      }
-      if(currPrecedence != 110) //operator found
-      {
-        if((currPrecedence <= minPrecedence) & (isOp == false) & (valid == 0)) //get lowest precedence operator, avoiding any unary operators
-        { 
-          op = expression.at(i).lexeme;
-          opTok = expression.at(i);
-          minPrecedence = currPrecedence;
-          index = i;
-          if(op == "=") //stop at the earliest `=` token
-          {
-            break;
-          }
-        }
-        isOp = true;
-      }
-      else
+      if(!expectOperand || operators.back().Kind == ExprFrame::PAREN) //`f()` has no argument to reduce
+        reduceGroup();
+      ExprFrame frame = std::move(operators.back());
+      operators.pop_back();
+      if(frame.Kind == ExprFrame::CALL)
       {
-        isOp = false;
+        vector<unique_ptr<ASTnode>> args;
+        for(size_t arg = frame.ArgsBegin; arg < operands.size(); arg++)
+          args.push_back(std::move(operands[arg]));
+        operands.resize(frame.ArgsBegin);
+        operands.push_back(make_unique<FuncCallASTnode>(frame.Tok.lexeme, std::move(args), frame.Tok));
       }
+      expectOperand = false;
     }
-
-    //split expression into two parts, either side of the operator
-    vector<TOKEN> lhs = {};
-    vector<TOKEN> rhs = {};
-    for(int i = 0; i < index; i++)
+    else if(getPrecedence(t.lexeme) != 110) //binary operator
     {
-      lhs.push_back(expression.at(i)); 
+      int precedence = getPrecedence(t.lexeme);
+      while(!operators.empty() && (operators.back().Kind == ExprFrame::UNARY ||
+            (operators.back().Kind == ExprFrame::BINARY && getPrecedence(operators.back().Tok.lexeme) >= precedence && t.lexeme != "=")))
+        reduce();
+      operators.push_back({ExprFrame::BINARY, t, 0});
+      expectOperand = true;
     }
-    for(int i = index+1; i < expression.size(); i++)
+    else
     {
-      rhs.push_back(expression.at(i));
+      operands.push_back(createOperandASTnode(t));
+      expectOperand = false;
     }
-
-    return std::move(make_unique<BinaryExprASTnode>(op, std::move(createExprASTnode(lhs)), std::move(createExprASTnode(rhs)),opTok)); //recursive call to parse both the lhs and rhs of the expression
   }
-  return nullptr;
+  while(!operators.empty())
+    reduce();
+  return operands.size() == 1 ? std::move(operands.back()) : nullptr;
+}
+
+//entry point for building the AST of a whole expression; it does not recurse, however deeply the expression nests,
+//but the passes over the tree it returns do (see CompilerStackSize)
+unique_ptr<ASTnode> createExprAST(const vector<TOKEN> &expression)
+{
+  ParseStats->Expressions++;
+  ParseStats->ExpressionTokens += expression.size();
+  ParseStats->MaxExpressionTokens = std::max(ParseStats->MaxExpressionTokens, (unsigned long)expression.size());
+  if(!PhaseTimerGroup || IsWorkerThread)
+    return createExprASTnode(expression);
+
+  //not a CompilePhase of its own: switching the phase timers for every expression costs more than building it, so
+  //expressions are timed with the steady clock and reported as part of parsing
+  auto start = std::chrono::steady_clock::now();
+  unique_ptr<ASTnode> expr = createExprASTnode(expression);
+  ExprBuildTime += std::chrono::steady_clock::now() - start;
+  return expr;
 }
 
 //===----------------------------------------------------------------------===//
@@ -1437,12 +1962,7 @@ bool p_param();
 bool p_block();
 bool p_local_decls();
 bool p_local_decl();
-bool p_stmt_list();
-bool p_stmt();
 bool p_expr_stmt();
-bool p_while_stmt();
-bool p_if_stmt();
-bool p_else_stmt();
 bool p_return_stmt(); bool p_return_stmt_prime();
 bool p_expr();
 bool p_exprStart();
@@ -1455,6 +1975,40 @@ bool p_rval_three(); bool p_rval_three_prime();
 bool p_rval_two(); bool p_rval_one(); bool p_rval();
 bool p_args(); bool p_arg_list(); bool p_arg_list_prime();
 
+//parses the body of a function definition or, with --lazy-bodies and -fparallel-parse, skims it by matching braces
+//and keeps its tokens, to be parsed by parseSkimmedBodies() once the whole file has been read
+static bool parseFunctionBody()
+{
+  if(!LazyBodies && !ParallelParse)
+    return p_block();
+
+  if(CurTok.type != LBRA)
+  {
+    if(!errorReported)
+      parseErrs()<<"Syntax error: Expected  {  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+    errorReported = true;
+    return false;
+  }
+  int depth = 0;
+  do
+  {
+    if(CurTok.type == EOF_TOK)
+    {
+      if(!errorReported)
+        parseErrs()<<"Syntax error: Expected  }  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+      errorReported = true;
+      return false;
+    }
+    if(CurTok.type == LBRA)
+      depth++;
+    else if(CurTok.type == RBRA)
+      depth--;
+    skimmedBody.push_back(CurTok);
+    getNextToken();
+  } while(depth > 0);
+  return true;
+}
+
 /* Defining functions for each production */
 
 /// arg_list' ::= "," arg_list | epsilon
@@ -1466,7 +2020,7 @@ bool p_arg_list_prime()
     if(!match(COMMA))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  ,  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  ,  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1485,7 +2039,7 @@ bool p_arg_list_prime()
     else
     {
       if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1513,7 +2067,7 @@ bool p_args()
     else
     {
       if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1529,7 +2083,7 @@ bool p_rval()
     if(!match(LPAR))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  (  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  (  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1539,7 +2093,7 @@ bool p_rval()
     if(!p_args())
     {
       if(!errorReported)
-        errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1548,7 +2102,7 @@ bool p_rval()
     if(!match(RPAR))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  )  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  )  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1567,7 +2121,7 @@ bool p_rval()
     else
     {
       if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1583,7 +2137,7 @@ bool p_rval_one()
     if(!match(LPAR))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  ()  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  ()  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1593,7 +2147,7 @@ bool p_rval_one()
     if(!p_expr())
     {
       if(!errorReported)
-        errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1602,7 +2156,7 @@ bool p_rval_one()
     if(!match(RPAR))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  )  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  )  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1616,7 +2170,7 @@ bool p_rval_one()
     if(!match(IDENT))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected an identifier at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected an identifier at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1632,7 +2186,7 @@ bool p_rval_one()
     if(!match(INT_LIT))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected an int literal at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected an int literal at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1648,7 +2202,7 @@ bool p_rval_one()
     if(!match(FLOAT_LIT))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected a float literal at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected a float literal at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1664,7 +2218,7 @@ bool p_rval_one()
     if(!match(BOOL_LIT))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected a bool literal at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected a bool literal at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1677,7 +2231,7 @@ bool p_rval_one()
   else
   {
     if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false;
   }
@@ -1692,7 +2246,7 @@ bool p_rval_two()
     if(!match(MINUS))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  -  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  -  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1706,7 +2260,7 @@ bool p_rval_two()
     if(!match(NOT))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  !  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  !  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1721,7 +2275,7 @@ bool p_rval_two()
   else
   {
     if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false;
   }
@@ -1742,7 +2296,7 @@ bool p_rval_three_prime()
     if(!match(ASTERIX))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  *  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  *  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1756,7 +2310,7 @@ bool p_rval_three_prime()
     if(!match(DIV))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  /  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  /  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1770,7 +2324,7 @@ bool p_rval_three_prime()
     if(!match(MOD))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected"<<"  %  "<<"at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected"<<"  %  "<<"at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1788,7 +2342,7 @@ bool p_rval_three_prime()
     else
     {
       if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1812,7 +2366,7 @@ bool p_rval_four_prime()
     if(!match(PLUS))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected"<<"  +  "<<"at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected"<<"  +  "<<"at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1827,7 +2381,7 @@ bool p_rval_four_prime()
     if(!match(MINUS))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  -  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  -  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1846,7 +2400,7 @@ bool p_rval_four_prime()
     else
     {
       if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1870,7 +2424,7 @@ bool p_rval_five_prime()
     if(!match(LE))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  <=  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  <=  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1884,7 +2438,7 @@ bool p_rval_five_prime()
     if(!match(LT))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  <  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  <  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1898,7 +2452,7 @@ bool p_rval_five_prime()
     if(!match(GE))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  >=  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  >=  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1912,7 +2466,7 @@ bool p_rval_five_prime()
     if(!match(GT))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  >  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  >  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1930,7 +2484,7 @@ bool p_rval_five_prime()
     else
     {
       if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1955,7 +2509,7 @@ bool p_rval_six_prime()
     if(!match(EQ))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  ==  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  ==  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1971,7 +2525,7 @@ bool p_rval_six_prime()
     if(!match(NE))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  !=  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  !=  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -1990,7 +2544,7 @@ bool p_rval_six_prime()
     else
     {
       if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2016,7 +2570,7 @@ bool p_rval_seven_prime()
     if(!match(AND))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  &&  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  &&  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2035,7 +2589,7 @@ bool p_rval_seven_prime()
     else
     {
       if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2059,7 +2613,7 @@ bool p_rval_eight_prime()
     if(!match(OR))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  ||  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  ||  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2069,7 +2623,7 @@ bool p_rval_eight_prime()
     if(!p_rval_seven())
     {
       if(!errorReported)
-        errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2077,7 +2631,7 @@ bool p_rval_eight_prime()
     if(!p_rval_eight_prime())
     {
       if(!errorReported)
-        errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2094,7 +2648,7 @@ bool p_rval_eight_prime()
     else
     {
       if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2110,11 +2664,12 @@ bool p_return_stmt_prime()
     if(!match(SC))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  ;  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  ;  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
 
+    stmtBlock->push_back(make_unique<ReturnExprASTnode>(nullptr, functiontype, nullToken));
     return true;
   }
   else if(contains(CurTok.type,FIRST_expr))
@@ -2122,20 +2677,20 @@ bool p_return_stmt_prime()
     if(!p_expr())
     {
       if(!errorReported)
-        errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
     
-    unique_ptr<ASTnode> expr = createExprASTnode(expression);
-    pair <string,unique_ptr<ASTnode>> p = make_pair("expr",std::move(expr));
-    stmtList.push_back(std::move(p));
+    unique_ptr<ASTnode> expr = createExprAST(expression);
+    TOKEN returnTok = (expr != nullptr) ? expr->getTok() : nullToken;
+    stmtBlock->push_back(make_unique<ReturnExprASTnode>(std::move(expr), functiontype, returnTok));
     resetExpression();
 
     if(!match(SC))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  ;  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  ;  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2145,7 +2700,7 @@ bool p_return_stmt_prime()
   else
   {
     if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false;
   }
@@ -2158,18 +2713,15 @@ bool p_return_stmt()
   if(!match(RETURN))
   {
     if(!errorReported)
-        errs()<<"Syntax error: Expected  `return`  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  `return`  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false;
   }
-  
-  pair <string,unique_ptr<ASTnode>> p = make_pair("return",std::move(nullptr));
-  stmtList.push_back(std::move(p));
 
   if(!p_return_stmt_prime())
   {
     if(!errorReported)
-      errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+      parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false;
   }
@@ -2184,7 +2736,7 @@ bool p_expr()
   if(!p_exprStart())
   {
     if(!errorReported)
-      errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+      parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false;
   }
@@ -2192,7 +2744,7 @@ bool p_expr()
   if(!p_rval_eight())
   {
     if(!errorReported)
-      errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+      parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false;
   }
@@ -2215,7 +2767,7 @@ bool p_exprStart() //has a look-ahead of two tokens
       if(!match(IDENT))
       {
         if(!errorReported)
-          errs()<<"Syntax error: Expected an identifier at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Expected an identifier at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
         errorReported = true;
         return false;
       }
@@ -2224,7 +2776,7 @@ bool p_exprStart() //has a look-ahead of two tokens
       if(!match(ASSIGN))
       {
         if(!errorReported)
-          errs()<<"Syntax error: Expected  =  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Expected  =  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
         errorReported = true;
         return false;
       }
@@ -2248,58 +2800,7 @@ bool p_exprStart() //has a look-ahead of two tokens
     else
     {
       if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
-      errorReported = true;
-      return false;
-    }
-  }
-}
-
-
-/// else_stmt  ::= "else" block | epsilon   
-bool p_else_stmt()
-{
-  if(CurTok.type == ELSE)
-  {
-    // return match(ELSE) & p_block();
-    if(!match(ELSE))
-    {
-      if(!errorReported)
-        errs()<<"Syntax error: Expected  `else`  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
-      errorReported = true;
-      return false;
-    }
-
-    pair <string,unique_ptr<ASTnode>> p = make_pair("else",std::move(nullptr));
-    stmtList.push_back(std::move(p));
-    
-    if(!p_block())
-    {
-      if(!errorReported)
-        errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
-      errorReported = true;
-      return false;
-    }
-
-    pair <string,unique_ptr<ASTnode>> end_else = make_pair("end_else",std::move(nullptr));
-    stmtList.push_back(std::move(end_else));
-
-    return true;
-
-  }
-  else
-  {
-    if(contains(CurTok.type,FOLLOW_else_stmt))
-    {
-      //consume token
-      pair <string,unique_ptr<ASTnode>> no_else = make_pair("no_else",std::move(nullptr));
-      stmtList.push_back(std::move(no_else));
-      return true;
-    }
-    else
-    {
-      if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2307,14 +2808,13 @@ bool p_else_stmt()
 }
 
 
- 
-/// if_stmt ::= "if" "(" expr ")" block else_stmt 
-bool p_if_stmt()
+//parses the `"if" "(" expr ")"` or `"while" "(" expr ")"` that starts an if_stmt or while_stmt, and builds its condition
+static bool p_condition(TOKEN_TYPE keyword, unique_ptr<ASTnode> &cond)
 {
-  if(!match(IF))
+  if(!match(keyword))
   {
     if(!errorReported)
-        errs()<<"Syntax error: Expected  `if`  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  `"<<(keyword == IF ? "if" : "while")<<"`  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false;
   }
@@ -2322,7 +2822,7 @@ bool p_if_stmt()
   if(!match(LPAR))
   {
     if(!errorReported)
-        errs()<<"Syntax error: Expected  (  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  (  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false;
   }
@@ -2330,7 +2830,7 @@ bool p_if_stmt()
   if(!p_expr())
   {
     if(!errorReported)
-      errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+      parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false;
   }
@@ -2338,97 +2838,14 @@ bool p_if_stmt()
   if(!match(RPAR))
   {
     if(!errorReported)
-        errs()<<"Syntax error: Expected  )  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
-    errorReported = true;
-    return false;
-  }
-  
-  pair <string,unique_ptr<ASTnode>> p = make_pair("if",std::move(nullptr));
-  stmtList.push_back(std::move(p));
-  unique_ptr<ASTnode> expr = createExprASTnode(expression);
-  pair <string,unique_ptr<ASTnode>> e = make_pair("expr",std::move(expr));
-  stmtList.push_back(std::move(e));
-  resetExpression();
-
-  if(!p_block())
-  {
-    if(!errorReported)
-      errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
-    errorReported = true;
-    return false;
-  }
-
-  pair <string,unique_ptr<ASTnode>> end_if = make_pair("end_if",std::move(nullptr));
-  stmtList.push_back(std::move(end_if));
-
-  if(!p_else_stmt())
-  {
-    if(!errorReported)
-      errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  )  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false;
   }
 
-  return true;
-}
-
-
-/// while_stmt ::= "while" "(" expr ")" stmt 
-bool p_while_stmt()
-{
-  // return match(WHILE) & match(LPAR) & p_expr() & match(RPAR) & p_stmt();
-  if(!match(WHILE))
-  {
-    if(!errorReported)
-        errs()<<"Syntax error: Expected  `while`  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
-      errorReported = true;
-    return false;
-  }
-
-  if(!match(LPAR))
-  {
-    if(!errorReported)
-        errs()<<"Syntax error: Expected  (  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
-      errorReported = true;
-    return false;
-  }
-
-  if(!p_expr())
-  {
-    if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
-      errorReported = true;
-    return false;
-  }
-
-  if(!match(RPAR))
-  {
-    if(!errorReported)
-        errs()<<"Syntax error: Expected  )  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
-      errorReported = true;
-    return false;
-  }
-  
-  pair <string,unique_ptr<ASTnode>> p = make_pair("while",std::move(nullptr));
-  stmtList.push_back(std::move(p));
-  unique_ptr<ASTnode> expr = createExprASTnode(expression);
-  pair <string,unique_ptr<ASTnode>> e = make_pair("expr",std::move(expr));
-  stmtList.push_back(std::move(e));
+  cond = createExprAST(expression);
   resetExpression();
-
-
-  if(!p_stmt())
-  {
-    if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
-      errorReported = true;
-    return false;
-  }
-  
-  pair <string,unique_ptr<ASTnode>> n = make_pair("end_while",std::move(nullptr));
-  stmtList.push_back(std::move(n));
   return true;
-
 }
 
 
@@ -2440,20 +2857,20 @@ bool p_expr_stmt()
     if(!p_expr())
     {
       if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
     if(!match(SC))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  ;  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  ;  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
-    unique_ptr<ASTnode> expr = createExprASTnode(expression);
-    pair <string,unique_ptr<ASTnode>> p = make_pair("expr",std::move(expr));
-    stmtList.push_back(std::move(p));
+    unique_ptr<ASTnode> expr = createExprAST(expression);
+    if(expr != nullptr)
+      stmtBlock->push_back(std::move(expr));
     resetExpression();
 
     return true;
@@ -2463,7 +2880,7 @@ bool p_expr_stmt()
      if(!match(SC))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  ;  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  ;  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2473,86 +2890,20 @@ bool p_expr_stmt()
   else
   {
     if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
-    errorReported = true;
-    return false;
-  }
-}
-
-
-/// stmt ::= expr_stmt | block | if_stmt | while_stmt | return_stmt
-bool p_stmt()
-{
-  if(contains(CurTok.type,FIRST_expr_stmt))
-  {
-    return p_expr_stmt();
-  }
-  else if(contains(CurTok.type,FIRST_block))
-  {
-    return p_block();
-  }
-  else if(contains(CurTok.type,FIRST_if_stmt))
-  {
-    return p_if_stmt();
-  }
-  else if(contains(CurTok.type,FIRST_while_stmt))
-  {
-    return p_while_stmt();
-  }
-  else if(contains(CurTok.type,FIRST_return_stmt))
-  {
-    return p_return_stmt();
-  }
-  else
-  {
-    if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false;
   }
 }
 
 
-/// stmt_list ::= stmt stmt_list | epsilon 
-bool p_stmt_list()
-{
-  if(contains(CurTok.type, FIRST_stmt_list))
-  {
-    if(!p_stmt())
-    {
-      if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
-      errorReported = true;
-      return false;
-    }
-    
-    return p_stmt_list();
-  }
-  else
-  {
-    if(contains(CurTok.type, FOLLOW_stmt_list))
-    {
-      //consume token
-      return true;
-    }
-    else
-    {
-      if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
-      errorReported = true;
-      return false;
-    }
-  }
-}
-
-
 ///local_decl ::= var_type IDENT ";" 
 bool p_local_decl()
 {
   if(!p_var_type())
   {
     if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
     return false;
   }
@@ -2561,7 +2912,7 @@ bool p_local_decl()
   if(!match(IDENT))
   {
     if(!errorReported)
-        errs()<<"Syntax error: Expected an identifier at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected an identifier at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false;
   }
@@ -2569,14 +2920,12 @@ bool p_local_decl()
   if(!match(SC))
   {
     if(!errorReported)
-        errs()<<"Syntax error: Expected  ;  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  ;  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false;
   }
 
-  unique_ptr<VariableASTnode> var = std::make_unique<VariableASTnode>(variableIdent, vartype, variableIdent.lexeme);
-  pair <string,unique_ptr<ASTnode>> p = make_pair("vardecl",std::move(var));
-  stmtList.push_back(std::move(p));
+  stmtBlock->push_back(std::make_unique<VariableASTnode>(variableIdent, vartype, variableIdent.lexeme));
   resetVariableToken();
   resetVartype();
 
@@ -2587,32 +2936,31 @@ bool p_local_decl()
 /// local_decls ::= local_decl local_decls | epsilon
 bool p_local_decls()
 {
-   if(contains(CurTok.type, FIRST_local_decl))
-   {
-      if(!p_local_decl())
-      {
-        if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
-      errorReported = true;
-        return false;
-      }
-      return p_local_decls();
-   }
-   else
-   {
-    if(contains(CurTok.type, FOLLOW_local_decls))
-    {
-      //consume token
-      return true;
-    }
-    else
+  while(contains(CurTok.type, FIRST_local_decl))
+  {
+    if(!p_local_decl())
     {
       if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
-      return false;
+      if(!recoverFromError())
+        return false;
+      skipStatement();
     }
-   }
+  }
+
+  if(contains(CurTok.type, FOLLOW_local_decls))
+  {
+    //consume token
+    return true;
+  }
+  else
+  {
+    if(!errorReported)
+        parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+    errorReported = true;
+    return false;
+  }
 }
 
 
@@ -2622,7 +2970,7 @@ bool p_param()
   if(!p_var_type())
   {
     if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
     return false;
   }
@@ -2632,7 +2980,7 @@ bool p_param()
   if(!match(IDENT))
   {
     if(!errorReported)
-        errs()<<"Syntax error: Expected an identifier at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected an identifier at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false;
   }
@@ -2646,45 +2994,183 @@ bool p_param()
 }
 
 
-/// block ::= "{" local_decls stmt_list "}" 
-bool p_block()
-{
+/// StmtFrame - a block, if_stmt or while_stmt that p_block() has started but not finished. Target is the block that the
+/// statements of a BLOCK, or the finished if or while statement, are added to
+struct StmtFrame {
+  enum FrameKind {BLOCK, IF_THEN, IF_ELSE, WHILE_START, WHILE_BODY} Kind;
+  vector<unique_ptr<ASTnode>> *Target;
+  unique_ptr<ASTnode> Cond;
+  vector<unique_ptr<ASTnode>> Then, Else;
+
+  StmtFrame(FrameKind kind, vector<unique_ptr<ASTnode>> *target, unique_ptr<ASTnode> cond = nullptr)
+    : Kind(kind), Target(target), Cond(std::move(cond)) {}
+};
 
+//matches the "{" and local_decls of a block whose statements go into target, and pushes its frame
+static bool startBlock(std::deque<StmtFrame> &frames, vector<unique_ptr<ASTnode>> *target)
+{
   if(!match(LBRA))
   {
     if(!errorReported)
-        errs()<<"Syntax error: Expected  {  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
-      errorReported = true;
+        parseErrs()<<"Syntax error: Expected  {  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+    errorReported = true;
     return false;
   }
 
+  stmtBlock = target;
   if(!p_local_decls())
   {
     if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
-      errorReported = true;
+        parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+    errorReported = true;
     return false;
   }
 
-   if(!p_stmt_list())
+  frames.emplace_back(StmtFrame::BLOCK, target);
+  return true;
+}
+
+/// stmt ::= expr_stmt | block | if_stmt | while_stmt | return_stmt
+//parses an expr_stmt or return_stmt into target, or starts a block, if_stmt or while_stmt by pushing its frame.
+//Returns false on a syntax error
+static bool startStmt(std::deque<StmtFrame> &frames, vector<unique_ptr<ASTnode>> *target)
+{
+  stmtBlock = target;
+  unique_ptr<ASTnode> cond;
+  if(contains(CurTok.type,FIRST_expr_stmt))
   {
-    if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
-      errorReported = true;
+    return p_expr_stmt();
+  }
+  else if(contains(CurTok.type,FIRST_block))
+  {
+    return startBlock(frames, target);
+  }
+  else if(contains(CurTok.type,FIRST_if_stmt))
+  {
+    if(!p_condition(IF, cond))
+      return false;
+    frames.emplace_back(StmtFrame::IF_THEN, target, std::move(cond));
+    if(startBlock(frames, &frames.back().Then))
+      return true;
+    frames.pop_back();
     return false;
   }
-
-  if(!match(RBRA))
+  else if(contains(CurTok.type,FIRST_while_stmt))
+  {
+    if(!p_condition(WHILE, cond))
+      return false;
+    frames.emplace_back(StmtFrame::WHILE_START, target, std::move(cond)); //p_block() starts the body
+    return true;
+  }
+  else if(contains(CurTok.type,FIRST_return_stmt))
+  {
+    return p_return_stmt();
+  }
+  else
   {
     if(!errorReported)
-        errs()<<"Syntax error: Expected  }  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false;
   }
+}
 
-  resetExpression();
+/// block ::= "{" local_decls stmt_list "}" 
+/// stmt_list ::= stmt stmt_list | epsilon 
+/// if_stmt ::= "if" "(" expr ")" block else_stmt 
+/// else_stmt  ::= "else" block | epsilon   
+/// while_stmt ::= "while" "(" expr ")" stmt 
+//Parses a block and every statement nested in it without recursing: the blocks, ifs and whiles that are still open
+//are kept on a stack of StmtFrames, so the nesting depth of a program does not use up the native stack. A statement
+//with a syntax error is reported and skipped by the innermost block around it; a block that cannot recover (at the
+//end of the file, or the error limit) fails the statements it is part of, up to the function body.
+bool p_block()
+{
+  vector<unique_ptr<ASTnode>> *outer = stmtBlock;
+  std::deque<StmtFrame> frames; //a deque, as Target points into the frames below the top one
+  bool parsed = startBlock(frames, outer); //whether the statement or block last finished was parsed without errors
 
-  return true;
+  while(!frames.empty())
+  {
+    StmtFrame &top = frames.back();
+    switch(top.Kind)
+    {
+    case StmtFrame::BLOCK:
+      if(!parsed)
+      {
+        if(!errorReported)
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        errorReported = true;
+        if(!recoverFromError())
+        {
+          frames.pop_back();
+          break;
+        }
+        skipStatement();
+      }
+
+      if(contains(CurTok.type, FIRST_stmt_list))
+      {
+        parsed = startStmt(frames, top.Target);
+      }
+      else if(contains(CurTok.type, FOLLOW_stmt_list))
+      {
+        parsed = match(RBRA);
+        if(!parsed)
+        {
+          if(!errorReported)
+            parseErrs()<<"Syntax error: Expected  }  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          errorReported = true;
+        }
+        resetExpression();
+        frames.pop_back();
+      }
+      else
+      {
+        if(!errorReported)
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        errorReported = true;
+        parsed = false; //recovered from at the top of the loop
+      }
+      break;
+
+    case StmtFrame::IF_THEN:
+      if(parsed && CurTok.type == ELSE)
+      {
+        match(ELSE);
+        top.Kind = StmtFrame::IF_ELSE;
+        parsed = startBlock(frames, &top.Else);
+        break;
+      }
+      if(parsed && !contains(CurTok.type, FOLLOW_else_stmt))
+      {
+        if(!errorReported)
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        errorReported = true;
+        parsed = false;
+      }
+      [[fallthrough]];
+    case StmtFrame::IF_ELSE:
+      if(parsed)
+        top.Target->push_back(make_unique<IfExprASTnode>(std::move(top.Cond), std::move(top.Then), std::move(top.Else)));
+      frames.pop_back();
+      break;
+
+    case StmtFrame::WHILE_START:
+      top.Kind = StmtFrame::WHILE_BODY;
+      parsed = startStmt(frames, &top.Then);
+      break;
+
+    case StmtFrame::WHILE_BODY:
+      if(parsed)
+        top.Target->push_back(make_unique<WhileExprASTnode>(std::move(top.Cond), std::move(top.Then)));
+      frames.pop_back();
+      break;
+    }
+  }
+
+  stmtBlock = outer;
+  return parsed;
 }
 
 
@@ -2696,7 +3182,7 @@ bool p_var_type()
     if(!match(INT_TOK))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  `int`  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  `int`  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2708,7 +3194,7 @@ bool p_var_type()
     if(!match(FLOAT_TOK))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  `float`  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  `float`  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2720,7 +3206,7 @@ bool p_var_type()
     if(!match(BOOL_TOK))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  `bool`  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  `bool`  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2730,7 +3216,7 @@ bool p_var_type()
   else
   {
     if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false;
   }
@@ -2745,7 +3231,7 @@ bool p_type_spec()
     if(!match(VOID_TOK))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  `void`   at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  `void`   at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2759,7 +3245,7 @@ bool p_type_spec()
   else
   {
     if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false;
   }
@@ -2776,7 +3262,7 @@ bool p_param_list_prime()
     if(!match(COMMA))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  ,  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  ,  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2784,7 +3270,7 @@ bool p_param_list_prime()
     if(!p_param_list())
     {
       if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2802,7 +3288,7 @@ bool p_param_list_prime()
     else
     {
       if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2840,7 +3326,7 @@ bool p_params()
       else
       {
         if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
         errorReported = true;
         return false; 
       }
@@ -2860,7 +3346,7 @@ bool p_decl_prime()
     if(!match(SC))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  ;  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  ;  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2880,7 +3366,7 @@ bool p_decl_prime()
     if(!match(LPAR))
     {
       if(!errorReported)
-          errs()<<"Syntax error: Expected  (  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Expected  (  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2888,7 +3374,7 @@ bool p_decl_prime()
     if(!p_params())
     {
       if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -2898,30 +3384,28 @@ bool p_decl_prime()
     if(!match(RPAR))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  )  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  )  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
 
     //variables for function prototype defined
 
-    if(!p_block())
+    if(!parseFunctionBody())
     {
       if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
 
-    addToBody();
-    resetStmtList();
     addFunctionAST(); 
     return true;
   }
   else
   {
     if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false; 
   }
@@ -2944,9 +3428,12 @@ bool p_extern_list_prime()
       else
       {
         if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
         errorReported = true;
-        return false; 
+        if(!recoverFromError())
+          return false;
+        skipDeclaration();
+        return p_extern_list_prime();
       }
    }
 }
@@ -2958,7 +3445,7 @@ bool p_extern()
   if(!match(EXTERN))
   {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  `extern`  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  `extern`  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
   }
@@ -2968,7 +3455,7 @@ bool p_extern()
   if(!p_type_spec())
   {
       if(!errorReported)
-        errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
   }
@@ -2981,7 +3468,7 @@ bool p_extern()
   if(!match(IDENT))
   {
       if(!errorReported)
-        errs()<<"Syntax error: Expected an identifier at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected an identifier at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
   }
@@ -2993,7 +3480,7 @@ bool p_extern()
   if(!match(LPAR))
   {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  (  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  (  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
   }
@@ -3001,7 +3488,7 @@ bool p_extern()
   if(!p_params())
   {
       if(!errorReported)
-        errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
   }
@@ -3009,7 +3496,7 @@ bool p_extern()
   if(!match(RPAR))
   {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  )  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  )  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
   }
@@ -3017,7 +3504,7 @@ bool p_extern()
    if(!match(SC))
   {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  ;  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  ;  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
   }
@@ -3048,9 +3535,12 @@ bool p_decl_list_prime()
       else
       {
         if(!errorReported)
-          errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+          parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
         errorReported = true;
-        return false; //fail
+        if(!recoverFromError())
+          return false;
+        skipDeclaration();
+        return p_decl_list_prime();
       }
    }
 }
@@ -3060,12 +3550,14 @@ bool p_decl_list_prime()
 /// decl ::= var_type IDENT decl' | "void" IDENT "(" params ")" block    
 bool p_decl()
 {
+  if(RecordTokens)
+    startRecordingDecl();
   if(contains(CurTok.type,FIRST_var_type))
   {
     if(!p_var_type())
     {
       if(!errorReported)
-        errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -3077,7 +3569,7 @@ bool p_decl()
     if(!match(IDENT))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected an identifier at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected an identifier at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -3094,7 +3586,7 @@ bool p_decl()
     if(!match(VOID_TOK))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  `void`  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  `void`  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -3105,7 +3597,7 @@ bool p_decl()
     if(!match(IDENT))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected an identifier at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected an identifier at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -3113,7 +3605,7 @@ bool p_decl()
      if(!match(LPAR))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  (  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  (  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -3121,7 +3613,7 @@ bool p_decl()
     if(!p_params())
     {
       if(!errorReported)
-        errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
@@ -3131,29 +3623,27 @@ bool p_decl()
     if(!match(RPAR))
     {
       if(!errorReported)
-        errs()<<"Syntax error: Expected  )  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Expected  )  at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
 
     //variables for function prototype defined
 
-    if(!p_block())
+    if(!parseFunctionBody())
     {
       if(!errorReported)
-        errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+        parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
       errorReported = true;
       return false;
     }
-    addToBody();
-    resetStmtList();
     addFunctionAST(); 
     return true;
   }
   else
   {
     if(!errorReported)
-      errs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
+      parseErrs()<<"Syntax error: Invalid token "<<CurTok.lexeme<<" found at line "<<CurTok.lineNo<<" column "<<CurTok.columnNo<<".\n";
     errorReported = true;
     return false; 
   }
@@ -3163,14 +3653,28 @@ bool p_decl()
 /// decl_list ::= decl decl_list'
 bool p_decl_list()
 {
-  return p_decl() & p_decl_list_prime();
+  if(!p_decl())
+  {
+    if(!recoverFromError())
+      return false;
+    skipDeclaration();
+  }
+  else if(Streaming && SyntaxErrors == 0 && !streamTopLevelNodes())
+    return false; //the error has been reported by semantic analysis or code generation
+  return p_decl_list_prime();
 }
 
 
 /// extern_list ::= extern extern_list' 
 bool p_extern_list()
 {
-  return p_extern() & p_extern_list_prime();
+  if(!p_extern())
+  {
+    if(!recoverFromError())
+      return false;
+    skipDeclaration();
+  }
+  return p_extern_list_prime();
 }
 
 
@@ -3191,1210 +3695,2795 @@ bool p_program()
   }
 }
 
+//--lazy-bodies: drops the function definitions that are not reachable from LazyRoots, before their bodies are parsed.
+//The calls in a body are found from its tokens (an identifier followed by "("), so the functions it reaches are known
+//before it is parsed
+static void dropUnreachableFunctions()
+{
+  std::map<string, FunctionAST*> definitions;
+  for(size_t i = 0; i < root.size(); i++)
+    if(root[i]->hasBody())
+    {
+      FunctionAST *F = static_cast<FunctionAST*>(root[i].get());
+      definitions[F->getProto().getFunctionName()] = F;
+    }
+
+  std::set<FunctionAST*> reachable;
+  vector<FunctionAST*> worklist;
+  for(const string &name : LazyRoots)
+  {
+    auto it = definitions.find(name);
+    if(it == definitions.end())
+      reportWarning(errs(), "Warning: Function " + name + " given to --lazy-bodies is not defined.\n");
+    else if(reachable.insert(it->second).second)
+      worklist.push_back(it->second);
+  }
+  while(!worklist.empty())
+  {
+    const vector<TOKEN> &tokens = worklist.back()->getBodyTokens();
+    worklist.pop_back();
+    for(size_t i = 0; i + 1 < tokens.size(); i++)
+    {
+      if(tokens[i].type != IDENT || tokens[i + 1].type != LPAR)
+        continue;
+      auto it = definitions.find(tokens[i].lexeme);
+      if(it != definitions.end() && reachable.insert(it->second).second)
+        worklist.push_back(it->second);
+    }
+  }
+
+  vector<unique_ptr<TopLevelASTnode>> kept;
+  for(size_t i = 0; i < root.size(); i++)
+  {
+    if(root[i]->hasBody() && !reachable.count(static_cast<FunctionAST*>(root[i].get())))
+      Stats.LazyBodiesDropped++;
+    else
+      kept.push_back(std::move(root[i]));
+  }
+  root = std::move(kept);
+}
+
+//Building expressions (createExprAST), parsing statements (p_block) and freeing the AST (releaseNodes) use explicit
+//work stacks, but semantic analysis, constant folding, code generation and the AST printout still recurse with the
+//nesting of the program, so the compiler and the parser's worker threads run with a large stack, where programs
+//100,000+ levels deep do not overflow it. The stack is only reserved - its pages are allocated as they are used.
+static const std::optional<unsigned> CompilerStackSize = 1u << 30;
+
+/// ParseChunk - consecutive top-level nodes whose skimmed function bodies are parsed by one worker thread
+struct ParseChunk {
+  size_t Begin, End;
+  vector<string> Diagnostics; //syntax errors and warnings of each node, in source order
+  CompileStats Stats; //the parser's counters
+  unsigned long NodesCreated[ASTnode::NumKinds];
+};
+
+static void parseChunk(ParseChunk &chunk, bool trace, unsigned traceGranularity) {
+  IsWorkerThread = true;
+  if(trace)
+    timeTraceProfilerInitialize(traceGranularity, "mccomp");
+  {
+  CompilePhase phase(PHASE_PARSE, "function bodies");
+  ParseStats = &chunk.Stats;
+  std::fill(std::begin(ASTnode::NodesCreated), std::end(ASTnode::NodesCreated), 0); //the thread may have parsed another chunk
+  ReplayingTokens = true;
+  chunk.Diagnostics.resize(chunk.End - chunk.Begin);
+  for(size_t i = chunk.Begin; i < chunk.End; i++)
+  {
+    if(!root[i]->hasBody())
+      continue;
+    //the body's tokens are replayed through the token buffer, followed by an EOF token
+    FunctionAST *F = static_cast<FunctionAST*>(root[i].get());
+    TOKEN eof = F->getBodyTokens().back();
+    eof.type = EOF_TOK;
+    eof.lexeme = "0";
+    tok_buffer.assign(F->getBodyTokens().begin(), F->getBodyTokens().end());
+    tok_buffer.push_back(eof);
+    raw_string_ostream diagnostics(chunk.Diagnostics[i - chunk.Begin]);
+    ParseDiagnostics = &diagnostics;
+    functiontype = F->getProto().getReturnType(); //for the return statements
+    errorReported = false;
+    stmtBlock = &body;
+    getNextToken();
+    if(p_block())
+      F->setBody(std::move(body));
+    resetBody();
+    resetExpression();
+    resetFunctiontype();
+    resetVartype();
+    resetVariableToken();
+    ParseDiagnostics = nullptr;
+  }
+  ReplayingTokens = false;
+  tok_buffer.clear();
+  std::copy(std::begin(ASTnode::NodesCreated), std::end(ASTnode::NodesCreated), chunk.NodesCreated);
+  ParseStats = &Stats;
+  }
+  if(trace)
+    timeTraceProfilerFinishThread(); //hands the worker's spans over to the main thread's trace
+}
+
+//prints diagnostics collected while parsing, counting the syntax errors, until the error limit is reached
+static void printParseDiagnostics(StringRef diagnostics)
+{
+  SmallVector<StringRef, 8> lines;
+  diagnostics.split(lines, '\n', -1, false);
+  for(StringRef line : lines)
+  {
+    if(ErrorLimitReached)
+      return;
+    errs()<<line<<"\n";
+    if(line.substr(0, 12) != "Syntax error")
+      ReportedWarnings += (line + "\n").str();
+    else if(++SyntaxErrors == ErrorLimit)
+    {
+      errs()<<"Too many syntax errors, stopping now (-ferror-limit="<<ErrorLimit<<").\n";
+      ErrorLimitReached = true;
+    }
+  }
+}
+
+//parses the skimmed bodies of the function definitions in root with the given number of threads. Once every body has
+//been parsed, the diagnostics of the bodies and of the top level are printed in source order, up to the error limit
+static void parseSkimmedBodies(unsigned jobs, unsigned traceGranularity)
+{
+  size_t totalTokens = 0;
+  for(size_t i = 0; i < root.size(); i++)
+    if(root[i]->hasBody())
+    {
+      totalTokens += static_cast<FunctionAST&>(*root[i]).getBodyTokens().size();
+      if(LazyBodies)
+        Stats.LazyBodiesParsed++;
+    }
+
+  //a few chunks of about the same number of tokens per thread, so a thread that gets large functions does not hold up the others
+  size_t numFunctions = std::count_if(root.begin(), root.end(), [](const unique_ptr<TopLevelASTnode> &node) { return node->hasBody(); });
+  vector<ParseChunk> chunks(std::min<size_t>(numFunctions, jobs * 4));
+  size_t node = 0, seen = 0;
+  for(size_t c = 0; c < chunks.size(); c++)
+  {
+    chunks[c].Begin = node;
+    size_t target = totalTokens * (c + 1) / chunks.size();
+    while(node < root.size() && seen < target)
+      if(root[node++]->hasBody())
+        seen += static_cast<FunctionAST&>(*root[node - 1]).getBodyTokens().size();
+    chunks[c].End = (c == chunks.size() - 1) ? root.size() : node;
+  }
+
+  bool trace = timeTraceProfilerEnabled();
+  std::atomic<size_t> next(0);
+  vector<llvm::thread> workers;
+  for(unsigned t = 0; t < std::min<size_t>(jobs, chunks.size()); t++)
+    workers.emplace_back(CompilerStackSize, [&] {
+      for(size_t c = next++; c < chunks.size(); c = next++)
+        parseChunk(chunks[c], trace, traceGranularity);
+    });
+  for(llvm::thread &worker : workers)
+    worker.join();
+
+  size_t printed = 0; //end of the top-level diagnostics printed so far
+  for(ParseChunk &chunk : chunks)
+  {
+    Stats.Expressions += chunk.Stats.Expressions;
+    Stats.ExpressionTokens += chunk.Stats.ExpressionTokens;
+    Stats.MaxExpressionTokens = std::max(Stats.MaxExpressionTokens, chunk.Stats.MaxExpressionTokens);
+    for(int i = 0; i < ASTnode::NumKinds; i++)
+      ASTnode::NodesCreated[i] += chunk.NodesCreated[i];
+
+    for(size_t i = chunk.Begin; i < chunk.End; i++)
+    {
+      if(!root[i]->hasBody())
+        continue;
+      size_t end = static_cast<FunctionAST&>(*root[i]).getTopLevelDiagnosticsEnd();
+      printParseDiagnostics(StringRef(TopLevelDiagnostics).slice(printed, end));
+      printed = end;
+      printParseDiagnostics(chunk.Diagnostics[i - chunk.Begin]);
+    }
+  }
+  printParseDiagnostics(StringRef(TopLevelDiagnostics).substr(printed));
+  TopLevelDiagnostics.clear();
+}
+
 //function to initialise parsing and get outcome, before moving on to code generation
-static bool parser() {
+static bool parser(unsigned jobs, unsigned traceGranularity) {
   getNextToken();
-  if(p_program() & (CurTok.type == EOF_TOK))
-  {
+  bool skimBodies = LazyBodies || ParallelParse;
+  raw_string_ostream topLevelDiagnostics(TopLevelDiagnostics);
+  if(skimBodies)
+    ParseDiagnostics = &topLevelDiagnostics;
+  bool parsed = p_program();
+  if(skimBodies)
+  {
+    ParseDiagnostics = nullptr;
+    SyntaxErrors = 0; //the errors are counted again as they are printed, in source order
+    errorReported = false;
+    if(LazyBodies)
+      dropUnreachableFunctions();
+    bool recordTokens = RecordTokens;
+    RecordTokens = false; //the function cache keys were computed from the tokens when the bodies were skimmed
+    parseSkimmedBodies(ParallelParse ? jobs : 1, traceGranularity);
+    RecordTokens = recordTokens;
+  }
+  int errors = SyntaxErrors + (errorReported && !ErrorLimitReached); //the last error may not have been recovered from
+  if(parsed && CurTok.type == EOF_TOK && errors == 0)
+  {
+    llvm::outs().flush(); //with --stream, the AST has already been printed to the same stdout
     cout<<"Parsing successful."<<endl;
     return true; //continue to print AST and generate IR
   }
   else
   {
+    if(errors > 1)
+      errs()<<errors<<" syntax errors.\n";
     return false;
   }
 
 }
 
 //===----------------------------------------------------------------------===//
-// Code Generation - Defining codegen() functions for each AST node
+// Constant Folding - simplifies constant subexpressions in the AST before code generation
 //===----------------------------------------------------------------------===//
 
-static LLVMContext TheContext;
-static IRBuilder<> Builder(TheContext);
-static std::unique_ptr<Module> TheModule;
+static bool foldingEnabled = true; //cleared by -fno-fold
 
-static vector<map<string,AllocaInst*>> NamedValuesList; //vector of symbol tables
-static map<string,GlobalVariable*> GlobalVariables; //symbol table for global variables
-
-static AllocaInst* CreateEntryBlockAlloca(Function *TheFunction, const std::string &VarName, string type) {
-  IRBuilder<> TmpB(&TheFunction->getEntryBlock(),
-  TheFunction->getEntryBlock().begin());
-  if(type == "int")
-    return TmpB.CreateAlloca(Type::getInt32Ty(TheContext), 0, VarName.c_str()); //the type (first argument) can be changed (for now its Int32)
-  else if(type == "float")
-    return TmpB.CreateAlloca(Type::getFloatTy(TheContext), 0, VarName.c_str());
-  else if(type == "bool")
-    return TmpB.CreateAlloca(Type::getInt1Ty(TheContext), 0, VarName.c_str());
-  else
-    return nullptr;
+//folds a child node, replacing it if the folder returns a simpler node
+static void foldChild(unique_ptr<ASTnode> &node)
+{
+  if(node == nullptr)
+    return;
+  unique_ptr<ASTnode> folded = node->foldConstants();
+  if(folded != nullptr)
+    node = std::move(folded);
 }
 
-Value *IntASTnode::codegen() {
-  return ConstantInt::get(TheContext, APInt(32,Val,true)); //int32 type
+//the value of a child that has already been folded: folding replaces every constant subexpression with a literal, so
+//only literals are checked rather than evaluating the child's subtree again, which is quadratic on long chains like a + a + ... + a
+static bool getFoldedConstant(const unique_ptr<ASTnode> &node, ConstantValue &val)
+{
+  return isa<IntASTnode, FloatASTnode, BoolASTnode>(node.get()) && node->getConstantValue(val);
 }
 
-Value *FloatASTnode::codegen() {
-  return ConstantFP::get(TheContext, APFloat(float(Val))); //float type
+static void foldBlock(vector<unique_ptr<ASTnode>> &block)
+{
+  for(int i = 0; i < block.size(); i++)
+    foldChild(block[i]);
 }
 
-Value *BoolASTnode::codegen() {
-  return ConstantInt::get(TheContext, APInt(1,int(Val),false)); //int1 type
+static unique_ptr<ASTnode> makeLiteral(const ConstantValue &val, TOKEN tok)
+{
+  if(val.Type == BOOL_TYPE)
+    return make_unique<BoolASTnode>(tok, val.IntVal != 0);
+  else if(val.Type == INT_TYPE)
+    return make_unique<IntASTnode>(tok, val.IntVal);
+  else
+    return make_unique<FloatASTnode>(tok, val.FloatVal);
 }
 
-Value *VariableASTnode::codegen() {
-  Function *TheFunction = Builder.GetInsertBlock()->getParent();
-  AllocaInst* varAlloca = CreateEntryBlockAlloca(TheFunction, Val, Type);
-  //store in NamedValues
-  std::map<std::string, AllocaInst*> NamedValues = NamedValuesList.back(); //obtain most recent symbol table (of current scope)
-  NamedValuesList.pop_back();
-  
-  if(NamedValues.insert({Val,varAlloca}).second == false) //check if symbol table already contains same variable name
-  {
-    string existTy = "";
-    if(NamedValues[Val]->getAllocatedType()->isIntegerTy(32))
-      existTy = "int";
-    else if(NamedValues[Val]->getAllocatedType()->isIntegerTy(1))
-      existTy = "bool";
-    else if(NamedValues[Val]->getAllocatedType()->isFloatTy())
-      existTy = "float";
-    
-    errs()<<"Semantic error: Redefinition of variable "<<Val<<" with different type "<<Type<<" at column no. "<<Tok.columnNo<<", line no. "<<Tok.lineNo<<". Variable "<<Val<<" of type "<<existTy<<" already exists within current scope.\n";
-    return nullptr;
-  }
-  NamedValuesList.push_back(NamedValues); //push symbol table back to the vector again after adding new variable
-  return varAlloca;
+//applies the same widening conversions as ImplicitCastASTnode::codegen(): bool to int is a zero extension, int to float is a signed conversion
+static ConstantValue widenConstant(ConstantValue val, MiniCType type)
+{
+  if(val.Type != FLOAT_TYPE && type == FLOAT_TYPE)
+    val.FloatVal = float(val.IntVal);
+  val.Type = type;
+  return val;
 }
 
-Value *VariableReferenceASTnode::codegen() {
-  // Look this variable up in the function.
-  AllocaInst *V;
+//wraps a folded int result to 32 bits like the `add`, `sub` and `mul` instructions would, warning if it is out of range
+static int wrapIntResult(long long result, TOKEN tok, bool warn)
+{
+  int wrapped = int((unsigned int)result);
+  if(warn && wrapped != result)
+    reportWarning(errs(), "Warning: Constant expression out of range for int type at line no. " + Twine(tok.lineNo) + " column no. " + Twine(tok.columnNo) + ". Value wraps around to " + Twine(wrapped) + ".\n");
+  return wrapped;
+}
 
-  //check through all symbol tables, starting from recent table
-  std::map<std::string, AllocaInst*> NamedValues;
-  int i;
-  for(i = NamedValuesList.size() - 1; i >= 0; i--)
-  {
-    NamedValues = NamedValuesList.at(i);
-    V = NamedValues[Name];
-    if(!V)
-    {
-      continue; //it is not a local variable - no alloca found
-    }
-    else
-    {
-      return V; //return alloca so it can be loaded
-    }
+static float checkFloatResult(float result, float lhs, float rhs, TOKEN tok, bool warn)
+{
+  if(warn && std::isinf(result) && !std::isinf(lhs) && !std::isinf(rhs))
+    reportWarning(errs(), "Warning: Constant expression out of range for float type at line no. " + Twine(tok.lineNo) + " column no. " + Twine(tok.columnNo) + ". Value set to " + (result > 0 ? "inf" : "-inf") + ".\n");
+  return result;
+}
 
-  }
-  
-  //check if its a global variable instead
-  GlobalVariable *GV = GlobalVariables[Name];
-  if(!GV)
-  {
-    errs()<<"Semantic error: Unknown variable name: "<<Name<<" at line no. "<<Tok.lineNo<<" column no. "<<Tok.columnNo<<".\n";
-    return nullptr;
-  }
-  else 
-  {
-    return GV; //return global variable
-  }
+//evaluates a unary operator on a constant operand, which has already been converted by the semantic analysis pass
+static bool foldUnaryOp(const string &op, ConstantValue operand, ConstantValue &result, TOKEN tok, bool warn)
+{
+  if(op == "!" & operand.Type == BOOL_TYPE)
+    result = {BOOL_TYPE, !operand.IntVal, 0.0f};
+  else if(op == "-" & operand.Type == FLOAT_TYPE)
+    result = {FLOAT_TYPE, 0, -operand.FloatVal};
+  else if(op == "-" & operand.Type == INT_TYPE)
+    result = {INT_TYPE, wrapIntResult(-(long long)operand.IntVal, tok, warn), 0.0f};
+  else
+    return false;
+  return true;
 }
 
-Value* UnaryExprASTnode::codegen()
-{ 
-  Value* operand = Operand->codegen();
+//evaluates a binary operator on two constants of the same type (the semantic analysis pass inserts the conversions)
+//returns false for division by zero (reported by the semantic analysis pass) and for results with undefined behaviour
+static bool foldBinaryOp(const string &op, ConstantValue lhs, ConstantValue rhs, ConstantValue &result, TOKEN tok, bool warn)
+{
+  if(lhs.Type != rhs.Type)
+    return false;
+  MiniCType type = lhs.Type;
 
-  if(operand == nullptr)
-    return nullptr;
-  
-  //load the operand depending on whether it is a local or global variable
-  if(auto *AI = dyn_cast<AllocaInst>(operand))
-  {
-    operand = Builder.CreateLoad(AI->getAllocatedType(),operand,"load_temp");
-  }
-  else if(auto *GV = dyn_cast<GlobalVariable>(operand))
+  if(op == "&&" | op == "||")
   {
-    operand = Builder.CreateLoad(GV->getValueType(),operand,"load_global_temp");
+    if(type != BOOL_TYPE)
+      return false;
+    result = {BOOL_TYPE, op == "&&" ? (lhs.IntVal & rhs.IntVal) : (lhs.IntVal | rhs.IntVal), 0.0f};
+    return true;
   }
 
-  //get the type of the operand
-  string type = "";
-
-  if(operand->getType()->isIntegerTy(32))
-  {
-    type = "int";
-  }
-  else if(operand->getType()->isIntegerTy(1))
-  {
-    type = "bool";
-  }
-  else if(operand->getType()->isFloatTy())
+  if(op == "==" | op == "!=" | op == "<=" | op == "<" | op == ">=" | op == ">")
   {
-    type = "float";
+    bool cmp = false;
+    if(type == FLOAT_TYPE) //ordered float comparisons
+    {
+      float l = lhs.FloatVal, r = rhs.FloatVal;
+      if(op == "==") cmp = l == r;
+      else if(op == "!=") cmp = l < r || l > r;
+      else if(op == "<=") cmp = l <= r;
+      else if(op == "<") cmp = l < r;
+      else if(op == ">=") cmp = l >= r;
+      else cmp = l > r;
+    }
+    else //signed int (or bool) comparisons
+    {
+      int l = lhs.IntVal, r = rhs.IntVal;
+      if(op == "==") cmp = l == r;
+      else if(op == "!=") cmp = l != r;
+      else if(op == "<=") cmp = l <= r;
+      else if(op == "<") cmp = l < r;
+      else if(op == ">=") cmp = l >= r;
+      else cmp = l > r;
+    }
+    result = {BOOL_TYPE, int(cmp), 0.0f};
+    return true;
   }
 
-  //unary operations only possible on operands of `bool` type
-  if(Opcode == "!") 
+  if(type == BOOL_TYPE) //1-bit arithmetic on two bools
   {
-    if(type == "bool")
-      return Builder.CreateNot(operand,"not_temp");
+    if(op == "+" | op == "-")
+      result = {BOOL_TYPE, lhs.IntVal ^ rhs.IntVal, 0.0f};
+    else if(op == "*")
+      result = {BOOL_TYPE, lhs.IntVal & rhs.IntVal, 0.0f};
     else
-    {
-      errs()<<"Semantic error:  Cannot cast from `"<<type<<"` to `bool` at line no. "<<Tok.lineNo<<" column no. "<<Tok.columnNo<<".\n";
-      return nullptr;    }
+      return false;
+    return true;
   }
-  else if(Opcode == "-")
+  else if(type == INT_TYPE)
   {
-    if(type == "bool")
+    long long l = lhs.IntVal, r = rhs.IntVal;
+    if(op == "+")
+      result = {INT_TYPE, wrapIntResult(l + r, tok, warn), 0.0f};
+    else if(op == "-")
+      result = {INT_TYPE, wrapIntResult(l - r, tok, warn), 0.0f};
+    else if(op == "*")
+      result = {INT_TYPE, wrapIntResult(l * r, tok, warn), 0.0f};
+    else if(op == "/" | op == "%")
     {
-      operand = Builder.CreateIntCast(operand, Type::getInt32Ty(TheContext), false);
+      if(r == 0 | (l == INT_MIN & r == -1)) //INT_MIN / -1 is undefined
+        return false;
+      result = {INT_TYPE, int(op == "/" ? l / r : l % r), 0.0f};
     }
-    else if(type == "float") 
+    else
+      return false;
+    return true;
+  }
+  else if(type == FLOAT_TYPE)
+  {
+    float l = lhs.FloatVal, r = rhs.FloatVal;
+    if(op == "+")
+      result = {FLOAT_TYPE, 0, checkFloatResult(l + r, l, r, tok, warn)};
+    else if(op == "-")
+      result = {FLOAT_TYPE, 0, checkFloatResult(l - r, l, r, tok, warn)};
+    else if(op == "*")
+      result = {FLOAT_TYPE, 0, checkFloatResult(l * r, l, r, tok, warn)};
+    else if(op == "/" | op == "%")
     {
-      return Builder.CreateFNeg(operand,"fneg_temp");
+      if(r == 0.0f)
+        return false;
+      result = {FLOAT_TYPE, 0, op == "/" ? checkFloatResult(l / r, l, r, tok, warn) : std::fmod(l, r)};
     }
-    return Builder.CreateNeg(operand,"neg_temp");
+    else
+      return false;
+    return true;
   }
-  else
-    return nullptr;
+  return false;
 }
 
-Value* BinaryExprASTnode::codegen(){
-  Value* lhs = LHS->codegen();
-  //boolean short circuit code generation for logical operators || and && - only works for constants (see `limitations` section in report)
-  if(Opcode == "&&")
-  {
-    if(lhs == ConstantInt::get(TheContext, APInt(1,int(false),false))) //return false if lhs is false
-      return ConstantInt::get(TheContext, APInt(1,int(false),false));
-  }
-  else if(Opcode == "||")
-  {
-    if(lhs == ConstantInt::get(TheContext, APInt(1,int(true),false))) //return true if lhs is true
-      return ConstantInt::get(TheContext, APInt(1,int(true),false));
-  }
-  Value* rhs = RHS->codegen();
+//constant expressions are evaluated without warnings here - the folder warns once it replaces them with a literal
+bool UnaryExprASTnode::getConstantValue(ConstantValue &val) const {
+  ConstantValue operand;
+  return Operand->getConstantValue(operand) && foldUnaryOp(Opcode, operand, val, Tok, false);
+}
 
-  bool isLHSAlloca = true;
+bool BinaryExprASTnode::getConstantValue(ConstantValue &val) const {
+  ConstantValue lhs, rhs;
+  return Opcode != "=" && LHS->getConstantValue(lhs) && RHS->getConstantValue(rhs) && foldBinaryOp(Opcode, lhs, rhs, val, Tok, false);
+}
 
-  if(lhs == nullptr | rhs == nullptr)
-    return nullptr;
+bool ImplicitCastASTnode::getConstantValue(ConstantValue &val) const {
+  if(!Operand->getConstantValue(val))
+    return false;
+  val = widenConstant(val, ExprType);
+  return true;
+}
 
-  //storing types of lhs and rhs
-  int lhsType = 0;
-  int rhsType = 0;
-  string lhsTypeStr = "";
-  string rhsTypeStr = "";
+unique_ptr<ASTnode> ImplicitCastASTnode::foldConstants() {
+  foldChild(Operand);
+  ConstantValue val;
+  if(getFoldedConstant(Operand, val))
+    return makeLiteral(widenConstant(val, ExprType), Operand->getTok());
+  return nullptr;
+}
 
-  if(Opcode != "=") //load LHS if it is not an assign operation
-  {
-    if(auto *AI = dyn_cast<AllocaInst>(lhs)) //for ordinary variable alloca
-    {
-      if(AI->getAllocatedType()->isFloatTy())
-        lhs = Builder.CreateLoad(Type::getFloatTy(TheContext), AI, "load_temp");
-      else if(AI->getAllocatedType()->isIntegerTy(32))
-        lhs = Builder.CreateLoad(Type::getInt32Ty(TheContext), AI, "load_temp");
-      else if(AI->getAllocatedType()->isIntegerTy(1))
-        lhs = Builder.CreateLoad(Type::getInt1Ty(TheContext), AI, "load_temp");
+unique_ptr<ASTnode> UnaryExprASTnode::foldConstants() {
+  foldChild(Operand);
 
-    }  
-    else if(auto *GV = dyn_cast<GlobalVariable>(lhs)) //for global variables
-    {
-      if(GV->getValueType()->isFloatTy())
-        lhs = Builder.CreateLoad(Type::getFloatTy(TheContext), GV, "load_global_temp");
-      else if(GV->getValueType()->isIntegerTy(32))
-        lhs = Builder.CreateLoad(Type::getInt32Ty(TheContext), GV, "load_global_temp");
-      else if(GV->getValueType()->isIntegerTy(1))
-        lhs = Builder.CreateLoad(Type::getInt1Ty(TheContext), GV, "load_global_temp");
-    }
-     if(lhs->getType()->isFloatTy())
-        lhsType = 2;
-      else if(lhs->getType()->isIntegerTy(32))
-        lhsType = 1;
-      else if(lhs->getType()->isIntegerTy(1))
-        lhsType = 0;
-  }
-  else //keep LHS as an alloca/global and get its type
+  ConstantValue val, result;
+  if(getFoldedConstant(Operand, val))
   {
-    if(auto *AI = dyn_cast<AllocaInst>(lhs))
-    {
-      if(AI->getAllocatedType()->isFloatTy())
-        lhsType = 2;
-      else if(AI->getAllocatedType()->isIntegerTy(32))
-        lhsType = 1;
-      else if(AI->getAllocatedType()->isIntegerTy(1))
-        lhsType = 0;
-    }
-    else if(auto *GV = dyn_cast<GlobalVariable>(lhs))
-    {
-      if(GV->getValueType()->isFloatTy())
-        lhsType = 2;
-      else if(GV->getValueType()->isIntegerTy(32))
-        lhsType = 1;
-      else if(GV->getValueType()->isIntegerTy(1))
-        lhsType = 0;
-    }
+    if(foldUnaryOp(Opcode, val, result, Tok, true))
+      return makeLiteral(result, Tok);
+    return nullptr;
   }
 
-  if(auto *AI = dyn_cast<AllocaInst>(rhs)) //load RHS
-  {
-    if(AI->getAllocatedType()->isFloatTy())
-      rhs = Builder.CreateLoad(Type::getFloatTy(TheContext), AI, "load_temp");
-    else if(AI->getAllocatedType()->isIntegerTy(32))
-      rhs = Builder.CreateLoad(Type::getInt32Ty(TheContext), AI, "load_temp");
-    else if(AI->getAllocatedType()->isIntegerTy(1))
-      rhs = Builder.CreateLoad(Type::getInt1Ty(TheContext), AI,"load_temp");
-  }
-  else if(auto *GV = dyn_cast<GlobalVariable>(rhs)) //if RHS is a global variable
+  //!!b is b, and --x is x (both operators keep the type of their operand once a bool has been cast for `-`)
+  if(auto *inner = dyn_cast<UnaryExprASTnode>(Operand.get()))
   {
-    if(GV->getValueType()->isFloatTy())
-      rhs = Builder.CreateLoad(Type::getFloatTy(TheContext), GV, "load_global_temp");
-    else if(GV->getValueType()->isIntegerTy(32))
-      rhs = Builder.CreateLoad(Type::getInt32Ty(TheContext), GV, "load_global_temp");
-    else if(GV->getValueType()->isIntegerTy(1))
-      rhs = Builder.CreateLoad(Type::getInt1Ty(TheContext), GV, "load_global_temp");
+    if(inner->Opcode == Opcode)
+      return std::move(inner->Operand);
   }
+  return nullptr;
+}
+
+unique_ptr<ASTnode> BinaryExprASTnode::foldConstants() {
+  if(Opcode != "=") //the LHS of an assignment is always a variable
+    foldChild(LHS);
+  foldChild(RHS);
+  if(Opcode == "=")
+    return nullptr;
 
-  //get type of loaded RHS
-  if(rhs->getType()->isIntegerTy(32))
-      rhsType = 1;
-    else if(rhs->getType()->isIntegerTy(1))
-      rhsType = 0;
-    else if(rhs->getType()->isFloatTy())
-      rhsType = 2;
+  ConstantValue lhsVal, rhsVal, result;
+  bool lhsConst = getFoldedConstant(LHS, lhsVal);
+  bool rhsConst = getFoldedConstant(RHS, rhsVal);
 
-  ///get types as a "string" - for printing errors
-  switch(lhsType)
+  if(lhsConst & rhsConst)
   {
-    case 0: lhsTypeStr = "bool"; break;
-    case 1: lhsTypeStr = "int"; break;
-    case 2: lhsTypeStr = "float"; break;
-    default: break;
+    if(foldBinaryOp(Opcode, lhsVal, rhsVal, result, Tok, true))
+      return makeLiteral(result, Tok);
+    return nullptr;
   }
 
-  switch(rhsType)
+  if(Opcode == "&&" | Opcode == "||") //same short circuits as codegenShortCircuit()
   {
-    case 0: rhsTypeStr = "bool"; break;
-    case 1: rhsTypeStr = "int"; break;
-    case 2: rhsTypeStr = "float"; break;
-    default: break;
-  }
-  
-    if(Opcode == "=") //ASSIGN
+    bool isAnd = (Opcode == "&&");
+    if(lhsConst)
     {
-      if(auto *st = dyn_cast<StoreInst>(rhs)) //get type again if a operand is a StoreInst e.g. a = b = 10;
-      {
-        rhs = st->getValueOperand();
+      if(lhsVal.IntVal == !isAnd) //false && x, true || x - x is never evaluated
+        return makeLiteral(lhsVal, Tok);
+      return std::move(RHS); //true && x, false || x
+    }
+    else if(rhsConst & rhsVal.IntVal == isAnd) //x && true, x || false
+      return std::move(LHS);
+    return nullptr;
+  }
 
-        if(rhs->getType()->isIntegerTy(32))
-          rhsType = 1;
-        else if(rhs->getType()->isIntegerTy(1))
-          rhsType = 0;
-        else if(rhs->getType()->isFloatTy())
-          rhsType = 2;
+  //algebraic identities: x + 0, 0 + x, x - 0, x * 1, 1 * x and x / 1
+  //(x + 0.0 is not simplified, since -0.0 + 0.0 is 0.0)
+  if(!(lhsConst | rhsConst))
+    return nullptr;
+  ConstantValue c = lhsConst ? lhsVal : rhsVal;
+  bool isFloat = (c.Type == FLOAT_TYPE);
+  bool isZero = isFloat ? c.FloatVal == 0.0f : c.IntVal == 0;
+  bool isOne = isFloat ? c.FloatVal == 1.0f : c.IntVal == 1;
+  unique_ptr<ASTnode> &other = lhsConst ? RHS : LHS;
+
+  if(Opcode == "+" & isZero & !isFloat)
+    return std::move(other);
+  if(Opcode == "-" & isZero & rhsConst)
+    return std::move(LHS);
+  if(Opcode == "*" & isOne & c.Type != BOOL_TYPE)
+    return std::move(other);
+  if(Opcode == "/" & isOne & rhsConst & c.Type != BOOL_TYPE)
+    return std::move(LHS);
+  return nullptr;
+}
 
-        switch(rhsType)
-        {
-          case 0: rhsTypeStr = "bool"; break;
-          case 1: rhsTypeStr = "int"; break;
-          case 2: rhsTypeStr = "float"; break;
-          default: break;
-        }
-      }
+unique_ptr<ASTnode> FuncCallASTnode::foldConstants() {
+  for(int i = 0; i < Args.size(); i++)
+    foldChild(Args[i]);
+  return nullptr;
+}
 
-      string name = LHS->getName(); //we know lhs is an alloca/global
-      if(name != "")
-      {
-        //perform widening conversion before storing to lhs
-        if(lhsType < rhsType)
-        {
-          errs()<<"Semantic error: Widening conversion not possible from RHS type "<<rhsTypeStr<<" to LHS type "<<lhsTypeStr<<" at line no. "<<Tok.lineNo<<" column no. "<<Tok.columnNo<<".\n";
-          return nullptr;
-        }
-        else if(lhsType > rhsType)//perform widening conversions
-        {
-            if(lhsType == 2) //to float
-            {
-              if(rhsType == 0) //bool to float
-              {
-                rhs = Builder.CreateIntCast(rhs, Type::getInt32Ty(TheContext), false);
-                rhs = Builder.CreateCast(Instruction::SIToFP,rhs,Type::getFloatTy(TheContext),"btof_cast");
-              }
-              else //int to float
-                rhs = Builder.CreateCast(Instruction::SIToFP,rhs,Type::getFloatTy(TheContext),"itof_cast");
-            }
-            else if(lhsType == 1) //bool to int
-              rhs = Builder.CreateIntCast(rhs, Type::getInt32Ty(TheContext), false, "btoi_cast");
- 
-        }
-          return Builder.CreateStore(rhs,lhs);
-      }
-      else
-        return nullptr;
-    }
+unique_ptr<ASTnode> IfExprASTnode::foldConstants() {
+  foldChild(Cond);
+  foldBlock(Then);
+  foldBlock(Else);
+  return nullptr;
+}
 
-    bool isLogical = false;
+unique_ptr<ASTnode> WhileExprASTnode::foldConstants() {
+  foldChild(Cond);
+  foldBlock(Then);
+  return nullptr;
+}
 
-    if(Opcode == "||" | Opcode == "&&")
-    {
-      isLogical = true;
-    }
+unique_ptr<ASTnode> ReturnExprASTnode::foldConstants() {
+  foldChild(ReturnExpr);
+  return nullptr;
+}
 
-   if(isLogical == true) //makes sure that the operands of logical operands are both `bool` types
-    {
-      if(lhsType == 2 | rhsType == 2)
-      {
-        errs()<<"Semantic error: Cannot cast from `float` to `bool` at line no. "<<Tok.lineNo<<" column no. "<<Tok.columnNo<<".\n";
-        return nullptr;
-      }
+void FunctionAST::foldConstants() {
+  foldBlock(Body);
+}
 
-      
-      if(lhsType == 1 | rhsType == 1)
-      {
-        errs()<<"Semantic error: Cannot cast from `int` to `bool` at line no. "<<Tok.lineNo<<" column no. "<<Tok.columnNo<<".\n";
-        return nullptr;
-      }
+//===----------------------------------------------------------------------===//
+// Semantic Analysis - resolves names and types, and inserts implicit conversions, before any code is generated
+//===----------------------------------------------------------------------===//
+
+//local variables in scope by name, each with the depth of its scope - the innermost declaration is last, so a lookup
+//is a single search however deeply the blocks are nested
+typedef map<string,vector<pair<size_t,VariableASTnode*>>> LocalSymbolTable;
+static LocalSymbolTable SemanticLocals;
+static vector<vector<LocalSymbolTable::iterator>> SemanticScopes; //the names declared in each local scope, innermost scope last
+static map<string,GlobalVariableAST*> SemanticGlobals; //symbol table for global variables
+static map<string,PrototypeAST*> SemanticFunctions; //functions declared so far, by name
+static set<string> SemanticDefinitions; //functions that already have a body
+
+//a widening conversion (or no conversion) from one type to another
+static bool canWiden(MiniCType from, MiniCType to)
+{
+  return from >= BOOL_TYPE & from <= to & to <= FLOAT_TYPE;
+}
+
+//wraps an expression in an implicit cast, if it does not already have the given type
+static void insertCast(unique_ptr<ASTnode> &node, MiniCType type)
+{
+  if(node->getExprType() != type)
+    node = make_unique<ImplicitCastASTnode>(std::move(node), type);
+}
+
+//void function calls can only be used as statements
+static bool checkNotVoid(ASTnode *node, TOKEN tok)
+{
+  if(node->getExprType() == VOID_TYPE)
+  {
+    errs()<<"Semantic error: Cannot use a value of type `void` at line no. "<<tok.lineNo<<" column no. "<<tok.columnNo<<".\n";
+    return false;
+  }
+  return true;
+}
+
+//operands of !, || and && must be a `bool`
+static bool checkBoolOperand(ASTnode *node, TOKEN tok)
+{
+  if(node->getExprType() != BOOL_TYPE)
+  {
+    errs()<<"Semantic error: Cannot cast from `"<<getTypeName(node->getExprType())<<"` to `bool` at line no. "<<tok.lineNo<<" column no. "<<tok.columnNo<<".\n";
+    return false;
+  }
+  return true;
+}
+
+static bool checkCondition(ASTnode *cond)
+{
+  if(cond->getExprType() != BOOL_TYPE)
+  {
+    errs()<<"Semantic error: Expected type `bool` for the condition statement at line no. "<<cond->getTok().lineNo<<" column no. "<<cond->getTok().columnNo<<". Cannot cast from type `"<<getTypeName(cond->getExprType())<<"` to `bool`.\n";
+    return false;
+  }
+  return true;
+}
+
+static void pushScope()
+{
+  SemanticScopes.push_back({});
+  Stats.MaxScopeDepth = std::max(Stats.MaxScopeDepth, (unsigned long)SemanticScopes.size());
+}
+
+static void popScope()
+{
+  for(LocalSymbolTable::iterator name : SemanticScopes.back())
+    name->second.pop_back();
+  SemanticScopes.pop_back();
+}
+
+static void declareLocal(const string &name, VariableASTnode *var)
+{
+  LocalSymbolTable::iterator it = SemanticLocals.insert({name, {}}).first;
+  it->second.push_back({SemanticScopes.size(), var});
+  SemanticScopes.back().push_back(it);
+}
+
+//checks each statement of a block in a new scope
+static bool checkBlock(vector<unique_ptr<ASTnode>> &block)
+{
+  pushScope();
+  for(int i = 0; i < block.size(); i++)
+    if(!block[i]->checkSemantics())
+      return false;
+  popScope();
+  return true;
+}
+
+//a block always returns if one of its statements is a return, or an if-else that returns on both branches
+//codegen() stops generating a block at the same statement
+static bool blockAlwaysReturns(const vector<unique_ptr<ASTnode>> &block)
+{
+  for(int i = 0; i < block.size(); i++)
+  {
+    if(isa<ReturnExprASTnode>(block[i].get()))
+      return true;
+    if(auto *ifExpr = dyn_cast<IfExprASTnode>(block[i].get()))
+      if(ifExpr->alwaysReturns())
+        return true;
+  }
+  return false;
+}
+
+bool IfExprASTnode::alwaysReturns() const {
+  return Else.size() != 0 && blockAlwaysReturns(Then) && blockAlwaysReturns(Else);
+}
+
+bool VariableASTnode::checkSemantics() {
+  auto existing = SemanticLocals.find(Val);
+  if(existing != SemanticLocals.end() && !existing->second.empty() && existing->second.back().first == SemanticScopes.size())
+  {
+    errs()<<"Semantic error: Redefinition of variable "<<Val<<" with different type "<<Type<<" at column no. "<<Tok.columnNo<<", line no. "<<Tok.lineNo<<". Variable "<<Val<<" of type "<<existing->second.back().second->getType()<<" already exists within current scope.\n";
+    return false;
+  }
+  declareLocal(Val, this);
+  return true;
+}
+
+bool VariableReferenceASTnode::checkSemantics() {
+  //the innermost local declaration of the name, if there is one
+  Stats.VariableLookups++;
+  Stats.ScopesSearched++;
+  auto local = SemanticLocals.find(Name);
+  if(local != SemanticLocals.end() && !local->second.empty())
+  {
+    Decl = local->second.back().second;
+    ExprType = Decl->getVarType();
+    return true;
+  }
+
+  //check if its a global variable instead
+  Stats.ScopesSearched++;
+  auto it = SemanticGlobals.find(Name);
+  if(it == SemanticGlobals.end())
+  {
+    errs()<<"Semantic error: Unknown variable name: "<<Name<<" at line no. "<<Tok.lineNo<<" column no. "<<Tok.columnNo<<".\n";
+    return false;
+  }
+  ExprType = it->second->getVarType();
+  return true;
+}
+
+bool UnaryExprASTnode::checkSemantics() {
+  if(!Operand->checkSemantics())
+    return false;
+
+  if(Opcode == "!") //only possible on operands of `bool` type
+  {
+    if(!checkBoolOperand(Operand.get(), Tok))
+      return false;
+    ExprType = BOOL_TYPE;
+  }
+  else //negation - a bool is extended to an int first
+  {
+    if(!checkNotVoid(Operand.get(), Tok))
+      return false;
+    if(Operand->getExprType() == BOOL_TYPE)
+      insertCast(Operand, INT_TYPE);
+    ExprType = Operand->getExprType();
+  }
+  return true;
+}
+
+bool BinaryExprASTnode::checkSemantics() {
+  if(!LHS->checkSemantics() || !RHS->checkSemantics())
+    return false;
+  MiniCType lhsType = LHS->getExprType();
+  MiniCType rhsType = RHS->getExprType();
+
+  if(Opcode == "=") //the LHS is always a variable - widen the RHS to its type before storing
+  {
+    if(!canWiden(rhsType, lhsType))
+    {
+      errs()<<"Semantic error: Widening conversion not possible from RHS type "<<getTypeName(rhsType)<<" to LHS type "<<getTypeName(lhsType)<<" at line no. "<<Tok.lineNo<<" column no. "<<Tok.columnNo<<".\n";
+      return false;
     }
-   
-        if(Opcode == "||") //OR
-          return Builder.CreateLogicalOr(lhs,rhs,"or_tmp"); 
-        else if(Opcode == "&&") //AND
-          return Builder.CreateLogicalAnd(lhs,rhs,"and_tmp"); 
+    cast<VariableReferenceASTnode>(LHS.get())->setLValue();
+    insertCast(RHS, lhsType);
+    ExprType = lhsType;
+    return true;
+  }
 
-      //Set both operands to equal types for +, -, *, /, %, ==, !=, <=, <, >= and > operators
+  if(Opcode == "&&" | Opcode == "||")
+  {
+    if(!checkBoolOperand(LHS.get(), Tok) || !checkBoolOperand(RHS.get(), Tok))
+      return false;
+    ExprType = BOOL_TYPE;
+    return true;
+  }
 
-      //for arithmetic operations, make sure to perform usual arithmetic conversions (get both operands to the same time) via widening only
-      if(lhsType != rhsType)
-      {
-        int returnType = lhsType;
-        if(rhsType > returnType)
-          returnType = rhsType;
-        
-        if(returnType == rhsType)
-        {
-            if(returnType == 2) //to float
-            {
-              if(lhsType == 0) //bool to float
-              {
-                lhs = Builder.CreateIntCast(lhs, Type::getInt32Ty(TheContext), false); //bool to int
-                lhs = Builder.CreateCast(Instruction::SIToFP,lhs,rhs->getType()); //int to float
-              }
-              else //int to float
-                lhs = Builder.CreateCast(Instruction::SIToFP,lhs,rhs->getType());
-              lhsType = 2;
-            }
-            else if(returnType == 1) //bool to int
-            {
-              lhs = Builder.CreateIntCast(lhs, Type::getInt32Ty(TheContext), false);
-              lhsType = 1;
-            }
-           
-        }
-        else
-        {
-          if(returnType == 2) //to float
-          {
-            if(rhsType == 0) //bool to float
-            {
-                rhs = Builder.CreateIntCast(rhs, Type::getInt32Ty(TheContext), false);
-                rhs = Builder.CreateCast(Instruction::SIToFP,rhs,lhs->getType());
-            }
-            else //int to float
-                rhs = Builder.CreateCast(Instruction::SIToFP,rhs,lhs->getType());
-            rhsType = 2;
-          }
-            else if(returnType == 1) //bool to int
-            {
-                rhs = Builder.CreateIntCast(rhs, Type::getInt32Ty(TheContext), false);
-                rhsType = 1;
-            }
-          }
-      }
+  if(!checkNotVoid(LHS.get(), Tok) || !checkNotVoid(RHS.get(), Tok))
+    return false;
 
-      if(Opcode == "+") //PLUS
-      {
-        if(rhs->getType()->isFloatTy() & lhs->getType()->isFloatTy()) //float
-          return Builder.CreateFAdd(lhs,rhs,"fadd_tmp");
-        else //for int or bool
-          return Builder.CreateAdd(lhs,rhs,"add_tmp");
-      }
-      else if(Opcode == "-") //MINUS
-      {
-        if(rhs->getType()->isFloatTy() & lhs->getType()->isFloatTy()) //float
-          return Builder.CreateFSub(lhs,rhs,"fsub_tmp");
-        else //for int or bool
-          return Builder.CreateSub(lhs,rhs,"sub_tmp");
-      }
-      else if(Opcode == "*") //MULT
-      {
-        if(rhs->getType()->isFloatTy() & lhs->getType()->isFloatTy()) //float
-          return Builder.CreateFMul(lhs,rhs,"fmul_tmp");
-        else //for int or bool
-          return Builder.CreateMul(lhs,rhs,"mul_tmp");
-      }
-      else if(Opcode == "/") //DIV - print error for zero division
-      {
-        if(rhs == ConstantInt::get(TheContext, APInt(32,int(0),false)) | rhs == ConstantInt::get(TheContext, APInt(1,int(false),false)) | rhs == ConstantFP::get(TheContext, APFloat(float(0.0))))
-        {
-          errs()<<"Semantic error: Division by zero not permitted at line no. "<<Tok.lineNo<<" column no. "<<Tok.columnNo<<".\n";
-          return nullptr;
-        }
+  //usual arithmetic conversions - both operands are widened to the same type
+  MiniCType operandType = std::max(lhsType, rhsType);
+  bool isComparison = (Opcode == "==" | Opcode == "!=" | Opcode == "<=" | Opcode == "<" | Opcode == ">=" | Opcode == ">");
+  if(isComparison & operandType == BOOL_TYPE & Opcode != "==" & Opcode != "!=") //bools are ordered as ints
+    operandType = INT_TYPE;
+  insertCast(LHS, operandType);
+  insertCast(RHS, operandType);
+  ExprType = isComparison ? BOOL_TYPE : operandType;
 
-        if(rhs->getType()->isFloatTy() & lhs->getType()->isFloatTy()) //float
-          return Builder.CreateFDiv(lhs,rhs,"fdiv_tmp");
-        else //for int or bool
-          return Builder.CreateSDiv(lhs,rhs,"div_tmp");
-      }
-      else if(Opcode == "%") //MOD - make sure second operand is not equal to 0, regardless of type
-      {
-        if(rhs == ConstantInt::get(TheContext, APInt(32,int(0),false)) | rhs == ConstantInt::get(TheContext, APInt(1,int(false),false)) | rhs == ConstantFP::get(TheContext, APFloat((float)0.0)))
-        {
-          errs()<<"Semantic error: Taking remainder of division with zero not permitted at line no. "<<Tok.lineNo<<" column no. "<<Tok.columnNo<<".\n";
-          return nullptr;
-        }
-        if(rhs->getType()->isFloatTy() & lhs->getType()->isFloatTy()) //float
-          return Builder.CreateFRem(lhs,rhs,"fmod_tmp");
-        else //for int or bool
-          return Builder.CreateSRem(lhs,rhs,"mod_tmp");
-      }
-      else if(Opcode == "==") //EQ
-      {
-        if(rhs->getType()->isFloatTy() & lhs->getType()->isFloatTy()) //float
-          return Builder.CreateFCmpOEQ(lhs,rhs,"feq_tmp");
-        else //for int or bool
-          return Builder.CreateICmpEQ(lhs,rhs,"eq_tmp");
-      }
-       else if(Opcode == "!=") //NEQ
-      {
-        if(rhs->getType()->isFloatTy() & lhs->getType()->isFloatTy()) //float
-          return Builder.CreateFCmpONE(lhs,rhs,"fne_tmp");
-        else //for int or bool
-          return Builder.CreateICmpNE(lhs,rhs,"ne_tmp");
-      }
-      else if(Opcode == "<=") //LE
-      {
-        if(rhs->getType()->isFloatTy() & lhs->getType()->isFloatTy()) //float
-          return Builder.CreateFCmpOLE(lhs,rhs,"fle_tmp");
-        else if(rhs->getType()->isIntegerTy(1) & lhs->getType()->isIntegerTy(1)) //bool
-        {
-          lhs = Builder.CreateIntCast(lhs, Type::getInt32Ty(TheContext), false);
-          rhs = Builder.CreateIntCast(rhs, Type::getInt32Ty(TheContext), false);
-        }
-       
-        return Builder.CreateICmpSLE(lhs,rhs,"le_tmp");
-      }
-      else if(Opcode == "<") //LT
-      {
-        if(rhs->getType()->isFloatTy() & lhs->getType()->isFloatTy()) //float
-          return Builder.CreateFCmpOLT(lhs,rhs,"flt_tmp");
-        else if(rhs->getType()->isIntegerTy(1) & lhs->getType()->isIntegerTy(1)) //bool
-        {
-          lhs = Builder.CreateIntCast(lhs, Type::getInt32Ty(TheContext), false);
-          rhs = Builder.CreateIntCast(rhs, Type::getInt32Ty(TheContext), false);
-        }
-        return Builder.CreateICmpSLT(lhs,rhs,"lt_tmp");
-      }
-      else if(Opcode == ">=") //GE
-      {
-        if(rhs->getType()->isFloatTy() & lhs->getType()->isFloatTy()) //float
-          return Builder.CreateFCmpOGE(lhs,rhs,"fge_tmp");
-        else if(rhs->getType()->isIntegerTy(1) & lhs->getType()->isIntegerTy(1)) //bool
-        {
-          lhs = Builder.CreateIntCast(lhs, Type::getInt32Ty(TheContext), false);
-          rhs = Builder.CreateIntCast(rhs, Type::getInt32Ty(TheContext), false);
-        }
-        return Builder.CreateICmpSGE(lhs,rhs,"ge_tmp");
-      }
-      else if(Opcode == ">") //GT
-      {
-        if(rhs->getType()->isFloatTy() & lhs->getType()->isFloatTy()) //float
-          return Builder.CreateFCmpOGT(lhs,rhs,"fgt_tmp");
-        else if(rhs->getType()->isIntegerTy(1) & lhs->getType()->isIntegerTy(1)) //bool
-        {
-          lhs = Builder.CreateIntCast(lhs, Type::getInt32Ty(TheContext), false);
-          rhs = Builder.CreateIntCast(rhs, Type::getInt32Ty(TheContext), false);
-        }
-        return Builder.CreateICmpSGT(lhs,rhs,"gt_tmp");
-      }
-      else
-        return nullptr;
+  //division by a constant zero, including constant expressions such as (1 - 1)
+  ConstantValue divisor;
+  if((Opcode == "/" | Opcode == "%") && RHS->getConstantValue(divisor))
+  {
+    bool isZero = (divisor.Type == FLOAT_TYPE) ? divisor.FloatVal == 0.0f : divisor.IntVal == 0;
+    if(isZero & Opcode == "/")
+    {
+      errs()<<"Semantic error: Division by zero not permitted at line no. "<<Tok.lineNo<<" column no. "<<Tok.columnNo<<".\n";
+      return false;
+    }
+    else if(isZero)
+    {
+      errs()<<"Semantic error: Taking remainder of division with zero not permitted at line no. "<<Tok.lineNo<<" column no. "<<Tok.columnNo<<".\n";
+      return false;
+    }
+  }
+  return true;
 }
 
-Value* FuncCallASTnode::codegen(){
-  // Look up the name in the global module table.
-  Function *CalleeF = TheModule->getFunction(Callee);
-  if (!CalleeF) //Function not found
+bool FuncCallASTnode::checkSemantics() {
+  Stats.FunctionLookups++;
+  auto it = SemanticFunctions.find(Callee);
+  if(it == SemanticFunctions.end()) //Function not found
   {
     errs()<<"Semantic error: Unknown function "<<Callee<<" referenced at line no. "<<Tok.lineNo<<" column no. "<<Tok.columnNo<<".\n";
-    return nullptr;
+    return false;
   }
-  // If argument mismatch error.
-  if (CalleeF->arg_size() != Args.size())
+  PrototypeAST *proto = it->second;
+  if(proto->getNumParams() != Args.size())
   {
     errs()<<"Semantic error: Incorrect no. of arguments passed for function "<<Callee<<" at line no. "<<Tok.lineNo<<" column no. "<<Tok.columnNo<<".\n";
-    return nullptr;
+    return false;
   }
-  
-  std::vector<Value *> ArgsV; //vector of arguments for function call
-  for (unsigned i = 0, e = Args.size(); i != e; ++i) 
+
+  //making sure the type of each argument is correct - if not, see if it can be widened
+  for(int i = 0; i < Args.size(); i++)
   {
-    Value* args = Args[i]->codegen(); //get alloca/global
-    string currType = "";
-    //load arguments
-    if(auto *AI = dyn_cast<AllocaInst>(args)) //for ordinary variable alloca
+    if(!Args[i]->checkSemantics())
+      return false;
+    MiniCType argType = Args[i]->getExprType();
+    MiniCType paramType = proto->getArg(i)->getVarType();
+    if(!canWiden(argType, paramType))
     {
-      if(AI->getAllocatedType()->isFloatTy())
-      {
-        args = Builder.CreateLoad(Type::getFloatTy(TheContext), AI, "load_arg");
-        currType = "float";
-      }
-      else if(AI->getAllocatedType()->isIntegerTy(32))
-      {
-        args = Builder.CreateLoad(Type::getInt32Ty(TheContext), AI, "load_arg");
-        currType = "int";
-      }
-      else if(AI->getAllocatedType()->isIntegerTy(1))
-      {
-        args = Builder.CreateLoad(Type::getInt1Ty(TheContext), AI, "load_arg");
-        currType = "bool";
-      }
+      errs()<<"Semantic error: Cannot cast from `"<<getTypeName(argType)<<"` to `"<<getTypeName(paramType)<<"` at line no. "<<Tok.lineNo<<" column no. "<<Tok.columnNo<<".\n";
+      return false;
+    }
+    insertCast(Args[i], paramType);
+  }
+  ExprType = getMiniCType(proto->getReturnType());
+  return true;
+}
 
-    }  
-    else if(auto *GV = dyn_cast<GlobalVariable>(args)) //for global variables
+bool IfExprASTnode::checkSemantics() {
+  return Cond->checkSemantics() && checkCondition(Cond.get()) && checkBlock(Then) && checkBlock(Else);
+}
+
+bool WhileExprASTnode::checkSemantics() {
+  return Cond->checkSemantics() && checkCondition(Cond.get()) && checkBlock(Then);
+}
+
+bool ReturnExprASTnode::checkSemantics() {
+  MiniCType correctType = getMiniCType(FuncReturnType);
+  if(ReturnExpr == nullptr)
+  {
+    if(correctType != VOID_TYPE)
     {
-      if(GV->getValueType()->isFloatTy())
-      {
-        args = Builder.CreateLoad(Type::getFloatTy(TheContext), GV, "load_global_arg");
-        currType = "float";
-      }
-      else if(GV->getValueType()->isIntegerTy(32))
-      {
-        args = Builder.CreateLoad(Type::getInt32Ty(TheContext), GV, "load_global_arg");
-        currType = "int";
-      }
-      else if(GV->getValueType()->isIntegerTy(1))
-      {
-        args = Builder.CreateLoad(Type::getInt1Ty(TheContext), GV, "load_global_arg");
-        currType = "bool";
-      }
+      errs()<<"Semantic Error: Return statement of type `"<<FuncReturnType<<"` expected, but no value is returned.\n";
+      return false;
     }
-    else
+    return true;
+  }
+
+  if(!ReturnExpr->checkSemantics())
+    return false;
+
+  //if type of return statement not correct, try to do widening conversion, otherwise error
+  MiniCType actualType = ReturnExpr->getExprType();
+  if(actualType != correctType)
+  {
+    if(!canWiden(actualType, correctType))
     {
-      if(args->getType()->isIntegerTy(32))
-      {
-        currType = "int";
-      }
-      else if(args->getType()->isIntegerTy(1))
-      {
-        currType = "bool";
-      }
-      else if(args->getType()->isFloatTy())
-      {
-        currType = "float";
-      }
+      errs()<<"Semantic Error: Incorrect return type `"<<getTypeName(actualType)<<"` used in line no: "<<Tok.lineNo<<" column no: "<<Tok.columnNo<<". Cannot cast to expected return type `"<<FuncReturnType<<"`.\n";
+      return false;
     }
+    reportWarning(errs(), "Warning: Incorrect return type `" + getTypeName(actualType) + "` used in line no: " + Twine(Tok.lineNo) + " column no: " + Twine(Tok.columnNo) + ". Casting to expected return type `" + FuncReturnType + "`.\n");
+    insertCast(ReturnExpr, correctType);
+  }
+  return true;
+}
+
+bool GlobalVariableAST::checkSemantics() {
+  auto existing = SemanticGlobals.find(Val);
+  if(existing != SemanticGlobals.end())
+  {
+    errs()<<"Semantic error: Redefinition of global variable "<<Val<<" with different type "<<Ty<<" at line no. "<<Tok.lineNo<<" column no. "<<Tok.columnNo<<". Variable "<<Val<<" of type "<<existing->second->getType()<<" already exists.\n";
+    return false;
+  }
+  SemanticGlobals.insert({Val, this});
+  return true;
+}
 
-    //making sure types of each argument is correct
-    //if not, see if it can be widened
-    Type* actualType = CalleeF->getArg(0)->getType();
-    string actualTypeStr = "";
+bool PrototypeAST::checkSemantics() {
+  SemanticFunctions.insert({getFunctionName(), this}); //calls resolve to the first declaration, like TheModule->getFunction()
+  return true;
+}
 
-    if(actualType->isIntegerTy(32))
-      actualTypeStr = "int";
-    else if(actualType->isIntegerTy(1))
-      actualTypeStr = "bool";
-    else if(actualType->isFloatTy())
-      actualTypeStr = "float";
+bool FunctionAST::checkSemantics() {
+  Proto->checkSemantics(); //declared before the body, so that the function can call itself
+  string returnType = Proto->getReturnType();
 
-    if(currType != actualTypeStr)
-    {
-      if(actualTypeStr == "bool")
-      {
-        errs()<<"Semantic error: Cannot cast from `"<<currType<<"` to `"<<actualTypeStr<<"` at line no. "<<Tok.lineNo<<" column no. "<<Tok.columnNo<<".\n";
-        return nullptr;
-      }
-      else if(actualTypeStr == "int")
-      {
-        if(currType == "float")
-        {
-          errs()<<"Semantic error: Cannot cast from `"<<currType<<"` to `"<<actualTypeStr<<"` at line no. "<<Tok.lineNo<<" column no. "<<Tok.columnNo<<".\n";
-          return nullptr;
-        }
-        else //bool to int
-        {
-          args = Builder.CreateIntCast(args, Type::getInt32Ty(TheContext), false, "btoi_cast");
-        }
-      }
-      else if(actualTypeStr == "float")
-      {
-        if(currType == "bool")
-        {
-          args = Builder.CreateIntCast(args, Type::getInt32Ty(TheContext), false);
-          args = Builder.CreateCast(Instruction::SIToFP,args,Type::getFloatTy(TheContext),"btof_cast");
-        }
-        else //int to float
-        {
-          args = Builder.CreateCast(Instruction::SIToFP,args,Type::getFloatTy(TheContext),"itof_cast");
-        }
-      }
-      }
+  if(SemanticDefinitions.insert(Proto->getFunctionName()).second == false)
+  {
+    errs()<<"Semantic error: Redefinition of function "<<Proto->getFunctionName()<<".\n";
+    return false;
+  }
 
-    ArgsV.push_back(args);
-    if (!ArgsV.back())
-      return nullptr;
+  if(Body.size() == 0 & returnType != "void") //empty function body
+  {
+    errs()<<"Semantic Error: Return statement of type  "<<returnType<<"  expected in function: "<<Proto->getName()<<".\n";
+    return false;
+  }
+
+  //parameters share the scope of the function body
+  pushScope();
+  for(int i = 0; i < Proto->getNumParams(); i++)
+    declareLocal(Proto->getArgName(i), Proto->getArg(i));
+  for(int i = 0; i < Body.size(); i++)
+    if(!Body[i]->checkSemantics())
+      return false;
+  popScope();
+
+  if(returnType != "void" && !blockAlwaysReturns(Body)) //return statement not found
+  {
+    errs()<<"Semantic Error: Return statement of type `"<<returnType<<"` expected in function: "<<Proto->getName()<<".\n";
+    return false;
+  }
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// Code Generation - Defining codegen() functions for each AST node
+// The AST has already been checked and typed by checkSemantics(), so this only lowers it to IR
+//===----------------------------------------------------------------------===//
+
+//The code generator's state is per thread: with -j, every worker of the parallel code generator has its own context and module
+static thread_local LLVMContext TheContext;
+static thread_local IRBuilder<> Builder(TheContext);
+static thread_local std::unique_ptr<Module> TheModule;
+
+static thread_local std::unique_ptr<legacy::FunctionPassManager> TheFPM; //per-function optimisation pipeline, only created for -O1 and -O2
+static int OptLevel = 0; //optimisation level given on the command line (-O0, -O1 or -O2)
+
+static thread_local map<string,GlobalVariable*> GlobalVariables; //symbol table for global variables
+static thread_local vector<FunctionStats> *GeneratedFunctions = &Stats.Functions; //where FunctionAST::codegen() records the size of each function
+
+//Redundant load elimination: the last value loaded from or stored to each variable in the current basic block.
+//A variable that is read again in the same block reuses that value instead of emitting another load.
+//Locals never have their address taken, so only their own stores change them; globals can also be changed by any call.
+static thread_local BasicBlock* LoadCacheBlock = nullptr;
+static thread_local map<Value*,Value*> LoadCache; //alloca or global variable -> current value
+
+static void clearLoadCache() {
+  LoadCache.clear();
+  LoadCacheBlock = nullptr;
+}
+
+//the cache only holds values of the block being generated, since they may not dominate any other block
+static map<Value*,Value*> &getLoadCache() {
+  if(Builder.GetInsertBlock() != LoadCacheBlock)
+  {
+    LoadCache.clear();
+    LoadCacheBlock = Builder.GetInsertBlock();
+  }
+  return LoadCache;
+}
+
+static Value* createCachedLoad(Type *type, Value *ptr, const Twine &name) {
+  map<Value*,Value*> &cache = getLoadCache();
+  auto it = cache.find(ptr);
+  if(it != cache.end())
+    return it->second;
+  Value* val = Builder.CreateLoad(type, ptr, name);
+  cache[ptr] = val;
+  return val;
+}
+
+//the stored value is forwarded to later loads of the variable in the same block
+static void createCachedStore(Value *val, Value *ptr) {
+  Builder.CreateStore(val, ptr);
+  getLoadCache()[ptr] = val;
+}
+
+//a call may store to any global variable
+static void invalidateGlobalsInLoadCache() {
+  map<Value*,Value*> &cache = getLoadCache();
+  for(auto it = cache.begin(); it != cache.end();)
+  {
+    if(isa<GlobalVariable>(it->first))
+      it = cache.erase(it);
+    else
+      ++it;
+  }
+}
+
+//Globals and functions are looked up through these, since a worker module of the parallel code generator only declares
+//the ones its functions use. In the main module everything has already been declared, in source order.
+static GlobalVariable* getGlobalVariable(const string &name) {
+  auto it = GlobalVariables.find(name);
+  if(it != GlobalVariables.end())
+    return it->second;
+  return SemanticGlobals.at(name)->declare();
+}
+
+static Function* getFunction(const string &name) {
+  if(Function *F = TheModule->getFunction(name))
+    return F;
+  return SemanticFunctions.at(name)->codegen();
+}
+
+//int is i32, float is float and bool is i1
+static Type* getLLVMType(MiniCType type) {
+  switch(type)
+  {
+    case BOOL_TYPE: return Type::getInt1Ty(TheContext);
+    case INT_TYPE: return Type::getInt32Ty(TheContext);
+    case FLOAT_TYPE: return Type::getFloatTy(TheContext);
+    default: return Type::getVoidTy(TheContext);
+  }
+}
+
+static AllocaInst* CreateEntryBlockAlloca(Function *TheFunction, const std::string &VarName, MiniCType type) {
+  IRBuilder<> TmpB(&TheFunction->getEntryBlock(),
+  TheFunction->getEntryBlock().begin());
+  return TmpB.CreateAlloca(getLLVMType(type), 0, VarName.c_str());
+}
+
+//Creates the per-function pipeline, which FunctionAST::codegen() runs on each function straight after it is verified,
+//while the function's IR is still hot in cache and before the next function is generated.
+//-O1 is the "lite" pipeline: Mini-C locals are all scalars, so mem2reg is enough to move every alloca into SSA registers;
+//instcombine and simplifycfg then clean up the casts, loads and branches left behind by codegen().
+//-O2 also removes redundant expressions across each function (early-cse, reassociate, gvn) and deletes dead code.
+static void InitializeFunctionPassManager() {
+  TheFPM = std::make_unique<legacy::FunctionPassManager>(TheModule.get());
+  TheFPM->add(createPromoteMemoryToRegisterPass());
+  if(OptLevel >= 2)
+  {
+    TheFPM->add(createEarlyCSEPass());
+    TheFPM->add(createReassociatePass());
+    TheFPM->add(createGVNPass());
+  }
+  TheFPM->add(createInstructionCombiningPass());
+  TheFPM->add(createCFGSimplificationPass());
+  if(OptLevel >= 2)
+    TheFPM->add(createDeadCodeEliminationPass());
+  TheFPM->doInitialization();
+}
+
+Value *IntASTnode::codegen() {
+  return ConstantInt::get(TheContext, APInt(32,Val,true)); //int32 type
+}
+
+Value *FloatASTnode::codegen() {
+  return ConstantFP::get(TheContext, APFloat(float(Val))); //float type
+}
+
+Value *BoolASTnode::codegen() {
+  return ConstantInt::get(TheContext, APInt(1,int(Val),false)); //int1 type
+}
+
+Value *VariableASTnode::codegen() {
+  Function *TheFunction = Builder.GetInsertBlock()->getParent();
+  Alloca = CreateEntryBlockAlloca(TheFunction, Val, getVarType());
+  return Alloca;
+}
+
+Value *VariableReferenceASTnode::codegen() {
+  //local variables were given an alloca when their declaration was generated
+  Value *ptr = (Decl != nullptr) ? (Value*)Decl->getAlloca() : (Value*)getGlobalVariable(Name);
+  if(ptr == nullptr)
+    return nullptr;
+  if(IsLValue) //address to store to
+    return ptr;
+  return createCachedLoad(getLLVMType(ExprType), ptr, (Decl != nullptr) ? "load_temp" : "load_global_temp");
+}
+
+Value* UnaryExprASTnode::codegen()
+{ 
+  Value* operand = Operand->codegen();
+  if(operand == nullptr)
+    return nullptr;
+
+  if(Opcode == "!")
+    return Builder.CreateNot(operand,"not_temp");
+  else if(ExprType == FLOAT_TYPE)
+    return Builder.CreateFNeg(operand,"fneg_temp");
+  else
+    return Builder.CreateNeg(operand,"neg_temp");
+}
+
+Value* ImplicitCastASTnode::codegen()
+{
+  Value* operand = Operand->codegen();
+  if(operand == nullptr)
+    return nullptr;
+
+  if(Operand->getExprType() == BOOL_TYPE)
+  {
+    if(ExprType == INT_TYPE) //bool to int
+      return Builder.CreateIntCast(operand, Type::getInt32Ty(TheContext), false, "btoi_cast");
+    operand = Builder.CreateIntCast(operand, Type::getInt32Ty(TheContext), false); //bool to float, through int
+    return Builder.CreateCast(Instruction::SIToFP,operand,Type::getFloatTy(TheContext),"btof_cast");
+  }
+  return Builder.CreateCast(Instruction::SIToFP,operand,Type::getFloatTy(TheContext),"itof_cast"); //int to float
+}
+
+//Short circuit code generation for logical operators || and &&
+//The RHS is only evaluated if the LHS does not already decide the result:
+// - a constant LHS folds the whole expression (or the RHS alone) without any branches
+// - a cheap RHS with no side effects is evaluated unconditionally and combined with a `select`
+// - otherwise the RHS gets its own basic block, and the result is merged with a PHI node
+Value* BinaryExprASTnode::codegenShortCircuit(){
+  bool isAnd = (Opcode == "&&");
+
+  Value* lhs = LHS->codegen();
+  if(lhs == nullptr)
+    return nullptr;
+
+  //result when the RHS is skipped: false for &&, true for ||
+  Constant* shortCircuitVal = ConstantInt::get(TheContext, APInt(1,int(!isAnd),false));
+  if(lhs == shortCircuitVal) //false && ..., true || ...
+    return shortCircuitVal;
+
+  int rhsCost = RHS->getSpeculationCost();
+  if(isa<Constant>(lhs) | (rhsCost >= 0 & rhsCost <= 4)) //true && rhs, false || rhs, or a cheap RHS
+  {
+    Value* rhs = RHS->codegen();
+    if(rhs == nullptr)
+      return nullptr;
+
+    if(isa<Constant>(lhs)) //the result is just the RHS
+      return rhs;
+    else if(isAnd) //AND
+      return Builder.CreateLogicalAnd(lhs,rhs,"and_tmp");
+    else //OR
+      return Builder.CreateLogicalOr(lhs,rhs,"or_tmp");
+  }
+
+  Function* TheFunction = Builder.GetInsertBlock()->getParent();
+  BasicBlock* lhsEnd = Builder.GetInsertBlock();
+  BasicBlock* rhs_ = BasicBlock::Create(TheContext, isAnd ? "and_rhs" : "or_rhs", TheFunction);
+  BasicBlock* end_ = BasicBlock::Create(TheContext, isAnd ? "and_end" : "or_end");
+
+  if(isAnd)
+    Builder.CreateCondBr(lhs, rhs_, end_);
+  else
+    Builder.CreateCondBr(lhs, end_, rhs_);
+
+  Builder.SetInsertPoint(rhs_);
+  Value* rhs = RHS->codegen();
+  if(rhs == nullptr)
+    return nullptr;
+  BasicBlock* rhsEnd = Builder.GetInsertBlock(); //RHS may have created blocks of its own
+  Builder.CreateBr(end_);
+
+  TheFunction->insert(TheFunction->end(), end_);
+  Builder.SetInsertPoint(end_);
+  PHINode* result = Builder.CreatePHI(Type::getInt1Ty(TheContext), 2, isAnd ? "and_tmp" : "or_tmp");
+  result->addIncoming(shortCircuitVal, lhsEnd);
+  result->addIncoming(rhs, rhsEnd);
+  return result;
+}
+
+Value* BinaryExprASTnode::codegen(){
+  if(Opcode == "&&" | Opcode == "||")
+    return codegenShortCircuit();
+
+  Value* lhs = LHS->codegen();
+  Value* rhs = RHS->codegen();
+  if(lhs == nullptr | rhs == nullptr)
+    return nullptr;
+
+  if(Opcode == "=") //ASSIGN - the value of the assignment is the stored value, e.g. for a = b = 10;
+  {
+    createCachedStore(rhs,lhs);
+    return rhs;
+  }
+
+  //both operands have the same type - bool operands of <=, <, >= and > have already been extended to int
+  bool isFloat = (LHS->getExprType() == FLOAT_TYPE);
+
+  if(Opcode == "+") //PLUS
+    return isFloat ? Builder.CreateFAdd(lhs,rhs,"fadd_tmp") : Builder.CreateAdd(lhs,rhs,"add_tmp");
+  else if(Opcode == "-") //MINUS
+    return isFloat ? Builder.CreateFSub(lhs,rhs,"fsub_tmp") : Builder.CreateSub(lhs,rhs,"sub_tmp");
+  else if(Opcode == "*") //MULT
+    return isFloat ? Builder.CreateFMul(lhs,rhs,"fmul_tmp") : Builder.CreateMul(lhs,rhs,"mul_tmp");
+  else if(Opcode == "/") //DIV
+    return isFloat ? Builder.CreateFDiv(lhs,rhs,"fdiv_tmp") : Builder.CreateSDiv(lhs,rhs,"div_tmp");
+  else if(Opcode == "%") //MOD
+    return isFloat ? Builder.CreateFRem(lhs,rhs,"fmod_tmp") : Builder.CreateSRem(lhs,rhs,"mod_tmp");
+  else if(Opcode == "==") //EQ
+    return isFloat ? Builder.CreateFCmpOEQ(lhs,rhs,"feq_tmp") : Builder.CreateICmpEQ(lhs,rhs,"eq_tmp");
+  else if(Opcode == "!=") //NEQ
+    return isFloat ? Builder.CreateFCmpONE(lhs,rhs,"fne_tmp") : Builder.CreateICmpNE(lhs,rhs,"ne_tmp");
+  else if(Opcode == "<=") //LE
+    return isFloat ? Builder.CreateFCmpOLE(lhs,rhs,"fle_tmp") : Builder.CreateICmpSLE(lhs,rhs,"le_tmp");
+  else if(Opcode == "<") //LT
+    return isFloat ? Builder.CreateFCmpOLT(lhs,rhs,"flt_tmp") : Builder.CreateICmpSLT(lhs,rhs,"lt_tmp");
+  else if(Opcode == ">=") //GE
+    return isFloat ? Builder.CreateFCmpOGE(lhs,rhs,"fge_tmp") : Builder.CreateICmpSGE(lhs,rhs,"ge_tmp");
+  else if(Opcode == ">") //GT
+    return isFloat ? Builder.CreateFCmpOGT(lhs,rhs,"fgt_tmp") : Builder.CreateICmpSGT(lhs,rhs,"gt_tmp");
+  else
+    return nullptr;
+}
+
+Value* FuncCallASTnode::codegen(){
+  // Look up the name in the global module table.
+  Function *CalleeF = getFunction(Callee);
+  if (!CalleeF)
+    return nullptr;
+
+  std::vector<Value *> ArgsV; //vector of arguments for function call, already converted to the parameter types
+  for (unsigned i = 0, e = Args.size(); i != e; ++i) 
+  {
+    ArgsV.push_back(Args[i]->codegen());
+    if (!ArgsV.back())
+      return nullptr;
+  }
+
+  invalidateGlobalsInLoadCache();
+  if(ExprType == VOID_TYPE)
+    return Builder.CreateCall(CalleeF, ArgsV); //void functions cannot have a name
+  else
+    return Builder.CreateCall(CalleeF, ArgsV, "call_tmp"); 
+}
+
+Value* IfExprASTnode::codegen(){
+
+  bool elseExist = false;
+   if(Else.size() != 0) //no need to create else branch if there is no else block
+    elseExist = true;
+  
+  //create necessary basic block to add expressions to
+  Function* TheFunction = Builder.GetInsertBlock()->getParent();
+  BasicBlock* true_ = BasicBlock::Create(TheContext, "if_then", TheFunction);
+  BasicBlock* false_;
+
+  if(elseExist)
+    false_ = BasicBlock::Create(TheContext, "if_else", TheFunction);
+
+  BasicBlock* end_ = BasicBlock::Create(TheContext, "if_end");
+  Value* cond = Cond->codegen(); //generate condition expression
+  if(cond == nullptr)
+      return nullptr;
+
+  Value* comp = Builder.CreateICmpNE(cond, ConstantInt::get(TheContext, APInt(1,0,false)), "if_cond");
+
+  //create conditional branch instruction
+  if(elseExist)
+    Builder.CreateCondBr(comp, true_, false_);
+  else
+    Builder.CreateCondBr(comp, true_, end_);
+
+  Builder.SetInsertPoint(true_);
+  ///Then block
+  bool generateBranchForThen = true;
+  bool generateBranchForElse = true;
+  Value* ret;
+
+  for(int i = 0; i < Then.size(); i++)
+  {
+    Value* thenVal = Then.at(i)->codegen();
+    if(thenVal == nullptr)
+      return nullptr;
+    if(auto *R = dyn_cast<ReturnInst>(thenVal))
+      {
+        ret = thenVal;
+        generateBranchForThen = false;
+        break; //don't generate IR for instructions after return
+      }
+  }
+
+  if(generateBranchForThen)
+    Builder.CreateBr(end_);  //create unconditional branch instruction to end, given that `if_then` block had no return statements
+
+  if(elseExist)
+  {
+    Builder.SetInsertPoint(false_);
+    ///Else block
+    for(int i = 0; i < Else.size(); i++)
+    {
+      Value* elseVal = Else.at(i)->codegen();
+      if(elseVal == nullptr)
+        return nullptr;
+      if(auto *R = dyn_cast<ReturnInst>(elseVal))
+      {
+        ret = elseVal;
+        generateBranchForElse = false;
+        break; //don't generate IR for instructions after return
+      }
+    }
+
+    if(generateBranchForElse)
+      Builder.CreateBr(end_); //create unconditional branch to end if else block has no return statements
+  }
+
+  if(generateBranchForThen | generateBranchForElse) //only generate 'if_end' block if 'if_then' and 'if_else' don't have a return stmt
+  {
+    TheFunction->insert(TheFunction->end(), end_);
+    Builder.SetInsertPoint(end_);
+    return ConstantPointerNull::get(PointerType::getUnqual(Type::getVoidTy(TheContext))); //return null pointer of void type
+  }
+  else
+    return ret;
+}
+
+Value* WhileExprASTnode::codegen(){
+  Function* TheFunction = Builder.GetInsertBlock()->getParent();
+  BasicBlock* cond_ = BasicBlock::Create(TheContext, "while_cond", TheFunction);
+  BasicBlock* true_ = BasicBlock::Create(TheContext, "while_body", TheFunction);
+  BasicBlock* false_ = BasicBlock::Create(TheContext, "while_end");
+  Builder.CreateBr(cond_);
+  Builder.SetInsertPoint(cond_);
+
+  Value* cond = Cond->codegen(); //generate condition expression
+  if(cond == nullptr)
+      return nullptr;
+
+  Value* comp = Builder.CreateICmpNE(cond, ConstantInt::get(TheContext, APInt(1,0, false)), "if_cond");
+  Builder.CreateCondBr(comp, true_, false_);
+  Builder.SetInsertPoint(true_);
+  ///Then block
+  bool generateBranchForBody = true;
+
+  for(int i = 0; i < Then.size(); i++)
+  {
+    Value* thenVal = Then.at(i)->codegen();
+    if(thenVal == nullptr)
+      return nullptr;
+    if(auto *R = dyn_cast<ReturnInst>(thenVal))
+      {
+        generateBranchForBody = false;
+        break; //don't generate IR for instructions after return
+      }
+  }
+  if(generateBranchForBody)
+    Builder.CreateBr(cond_); //if body doesn't contain return statement, make unconditional jump to cond branch
+
+  TheFunction->insert(TheFunction->end(), false_);
+  Builder.SetInsertPoint(false_);
+  return ConstantPointerNull::get(PointerType::getUnqual(Type::getVoidTy(TheContext))); //return null pointer of void type
+ 
+}
+
+Value* ReturnExprASTnode::codegen(){
+  if(ReturnExpr == nullptr)
+  {
+    return Builder.CreateRetVoid();
+  }
+  Value* returnExpr = ReturnExpr->codegen(); //already converted to the return type of the function
+  if(returnExpr == nullptr)
+    return nullptr;
+  return Builder.CreateRet(returnExpr);
+}
+
+Function* PrototypeAST::codegen(){
+  // Make the function type:
+  vector<Type *> ArgTypes;
+  for(int i = 0; i < getNumParams(); i++)
+    ArgTypes.push_back(getLLVMType(Args.at(i)->getVarType()));
+
+  FunctionType *FT = FunctionType::get(getLLVMType(getMiniCType(getReturnType())), ArgTypes, false);
+
+ Function *F = Function::Create(FT, Function::ExternalLinkage, getFunctionName(), TheModule.get());
+ //Set names for all arguments.
+ unsigned Idx = 0;
+ for (auto &Arg : F->args())
+ {
+   Arg.setName(getArgName(Idx));
+   Idx++;
+ }
+
+ return F;
+}
+
+Value* GlobalVariableAST::codegen(){
+  bool isConstant = false; 
+  Type* t = getLLVMType(getVarType());
+  int alignSize = (getVarType() == BOOL_TYPE) ? 1 : 4; //set correct alignment
+
+  //create new global variable and set name
+  GlobalVariable* g = new GlobalVariable(*(TheModule.get()),t,isConstant,GlobalValue::CommonLinkage,Constant::getNullValue(t));
+  g->setAlignment(MaybeAlign(alignSize));
+  g->setName(Val);
+
+  GlobalVariables[Val] = g; //add global variable to global symbol table
+  return g;
+}
+
+GlobalVariable* GlobalVariableAST::declare(){
+  GlobalVariable* g = new GlobalVariable(*(TheModule.get()),getLLVMType(getVarType()),false,GlobalValue::ExternalLinkage,nullptr,Val);
+  g->setAlignment(MaybeAlign((getVarType() == BOOL_TYPE) ? 1 : 4));
+  GlobalVariables[Val] = g;
+  return g;
+}
+
+Function* FunctionAST::codegen(){
+  CompilePhase phase(PHASE_CODEGEN, Proto->getFunctionName()); //one span per function in --time-trace
+  Function *TheFunction = TheModule->getFunction(Proto->getFunctionName()); //may have been declared by an extern
+
+if (!TheFunction)
+  TheFunction = Proto->codegen();
+if (!TheFunction)
+  return nullptr;
+ BasicBlock *BB = BasicBlock::Create(TheContext, "entry", TheFunction);
+ Builder.SetInsertPoint(BB);
+ clearLoadCache(); //blocks of the previous function may have been deleted by the optimiser, and their addresses reused
+
+ for (int i = 0; i < Proto->getNumParams(); i++) //creating an alloca for each argument, so it can be assigned to like a local variable
+ {
+    VariableASTnode *param = Proto->getArg(i);
+    AllocaInst *Alloca = CreateEntryBlockAlloca(TheFunction, param->getVal(), param->getVarType());
+    createCachedStore(TheFunction->getArg(i), Alloca);
+    param->setAlloca(Alloca);
+ }
+
+ bool returnSet = false;
+for(int i = 0; i < Body.size(); i++)
+{
+  Value *RetVal = Body.at(i)->codegen(); //go through all ASTnodes in this function body and run codegen() for each ASTnode
+  if(!RetVal)
+  {
+    return nullptr;
+  }
+  if(isa<ReturnInst>(RetVal))
+  {
+    returnSet = true;
+    break; //do not generate further instructions after the return statement
+  }
+}
+
+if(!returnSet) //only void functions can reach the end of their body, checked by checkSemantics()
+  Builder.CreateRetVoid();
+
+if(StatsEnabled)
+  GeneratedFunctions->push_back({Proto->getFunctionName(), (unsigned)TheFunction->size(), TheFunction->getInstructionCount(),
+                             (unsigned)TheFunction->size(), TheFunction->getInstructionCount()});
+
+// Validate the generated code, checking
+//for consistency.
+ bool isBroken;
+ {
+   CompilePhase verifyPhase(PHASE_VERIFY, Proto->getFunctionName());
+   isBroken = verifyFunction(*TheFunction);
+ }
+
+ //optimise the function as soon as it is complete (only if -O1/-O2 is given and the IR is valid)
+ if(TheFPM && !isBroken)
+ {
+   CompilePhase optPhase(PHASE_OPT, Proto->getFunctionName());
+   TheFPM->run(*TheFunction);
+   if(StatsEnabled)
+   {
+     GeneratedFunctions->back().OptBlocks = TheFunction->size();
+     GeneratedFunctions->back().OptInstructions = TheFunction->getInstructionCount();
+   }
+ }
+
+ return TheFunction;
+}
+
+//===----------------------------------------------------------------------===//
+// Compilation cache - for --cache-dir and --incremental
+// The output files of a compilation are stored together in one entry, named llvmcache-<key> so that LLVM's
+// pruneCache() evicts the least recently used entries once the cache is over its size limit. The key is the SHA1 of
+// everything the output depends on: the compiler executable, the flags that change the output, the host target and the
+// source. On a hit the files are copied out of the entry without lexing, parsing or generating any code, and the
+// warnings of the compile that stored it, which are kept in the entry too, are printed again.
+// With --incremental, a miss still reuses the optimised IR of every function that has not changed: each function
+// definition has its own entry, holding the bitcode of a module with just that function, keyed by the function's
+// tokens and the declarations of the globals and functions it names. Only the other functions are generated, and the
+// module is linked together from both, as for -j.
+//===----------------------------------------------------------------------===//
+
+static const char *MainArgv0 = "mccomp"; //set by main(), to find the executable if /proc/self/exe is not available
+static const StringRef CacheMagic = "mccomp-cache\n"; //followed by "<size>\n<warnings>", then "<name>\n<size>\n<bytes>" for each output file
+static string FunctionCacheDir = ""; //set by --incremental
+
+//the xxHash64 of the mccomp executable, so that a rebuilt compiler never reuses old entries, however quickly it was
+//rebuilt; only hashed once, and by the compile server before it forks, so its requests do not hash it again
+static const string &getCompilerVersion() {
+  static const string version = [] {
+    string exe = sys::fs::getMainExecutable(MainArgv0, (void*)&getCompilerVersion);
+    ErrorOr<std::unique_ptr<MemoryBuffer>> binary = MemoryBuffer::getFile(exe, false, false);
+    if(!binary)
+      return string("mccomp " __DATE__ " " __TIME__); //cannot happen in practice, as the executable is running
+    return "mccomp " + utohexstr(xxHash64((*binary)->getBuffer()));
+  }();
+  return version;
+}
+
+static string getCacheKey(StringRef data) {
+  string key = getCompilerVersion() + '\0' + sys::getDefaultTargetTriple() + '\0' + data.str();
+  return toHex(SHA1::hash(arrayRefFromStringRef(key)), true);
+}
+
+static string getCacheKey(StringRef source, StringRef flags) {
+  return getCacheKey(flags.str() + '\0' + source.str());
+}
+
+//the optimised IR of a function depends on its own tokens and on the declarations it uses, but not on the other
+//function bodies; a name that is declared both as a function and as a global contributes both declarations
+static string getFunctionCacheKey(const FunctionAST &F) {
+  string data = "function -O" + std::to_string(OptLevel) + (foldingEnabled ? "" : " -fno-fold") + '\0' + F.getTokenDigest();
+  for(const string &name : F.getIdentifiers())
+  {
+    auto global = SemanticGlobals.find(name);
+    if(global != SemanticGlobals.end())
+    {
+      data += '\0'; //appended on its own, as "\0global " would be an empty C string
+      data += "global " + global->second->getType() + " " + name;
+    }
+    auto function = SemanticFunctions.find(name);
+    if(function != SemanticFunctions.end())
+    {
+      const PrototypeAST *proto = function->second;
+      data += '\0';
+      data += "function " + proto->getReturnType() + " " + name + "(";
+      for(int i = 0; i < proto->getNumArgs(); i++)
+        data += proto->getArg(i)->getType() + ",";
+      data += ")";
+    }
+  }
+  return getCacheKey(data);
+}
+
+//hits and misses are counted by appending a byte to a file, which is safe with concurrent compilers
+static void countCacheLookup(StringRef dir, bool hit) {
+  int FD;
+  if(!sys::fs::openFileForWrite(dir + (hit ? "/stats.hits" : "/stats.misses"), FD, sys::fs::CD_OpenAlways, sys::fs::OF_Append))
+    raw_fd_ostream(FD, true) << '.';
+}
+
+static std::unique_ptr<MemoryBuffer> readCacheEntry(StringRef dir, StringRef key) {
+  string path = (dir + "/llvmcache-" + key).str();
+  ErrorOr<std::unique_ptr<MemoryBuffer>> entry = MemoryBuffer::getFile(path);
+  if(!entry)
+    return nullptr;
+
+  //pruneCache() evicts by access time, which the file system may not update by itself
+  int FD;
+  if(!sys::fs::openFileForRead(path, FD))
+  {
+    sys::fs::setLastAccessAndModificationTime(FD, std::chrono::system_clock::now());
+    sys::Process::SafelyCloseFileDescriptor(FD);
+  }
+  return std::move(*entry);
+}
+
+//the entry is written to a temporary file and renamed into place, so concurrent compilers never see a partial entry;
+//if two of them store the same key, the last rename wins with identical contents
+static void writeCacheEntry(StringRef dir, StringRef key, StringRef data) {
+  Expected<sys::fs::TempFile> temp = sys::fs::TempFile::create(dir + "/tmp-%%%%%%%%%%%%");
+  if(!temp)
+  {
+    consumeError(temp.takeError());
+    return;
+  }
+  raw_fd_ostream out(temp->FD, false);
+  out << data;
+  out.flush();
+  if(out.has_error()) //e.g. the disk is full - the partial entry is removed rather than renamed into place
+  {
+    out.clear_error();
+    consumeError(temp->discard());
+    return;
+  }
+  if(Error E = temp->keep(dir + "/llvmcache-" + key))
+    consumeError(std::move(E));
+}
+
+//writes out the files of the entry for key, if there is one, and returns the warnings stored with them
+static bool restoreFromCache(StringRef dir, StringRef key, string &warnings) {
+  std::unique_ptr<MemoryBuffer> entry = readCacheEntry(dir, key);
+  if(!entry)
+    return false;
+  StringRef data = entry->getBuffer();
+  StringRef size;
+  unsigned long long length;
+  if(!data.consume_front(CacheMagic))
+    return false;
+  std::tie(size, data) = data.split('\n');
+  if(size.getAsInteger(10, length) || length > data.size())
+    return false;
+  warnings = data.take_front(length).str();
+  data = data.drop_front(length);
+
+  vector<pair<StringRef,StringRef>> files;
+  while(!data.empty())
+  {
+    StringRef name, size;
+    unsigned long long length;
+    std::tie(name, data) = data.split('\n');
+    std::tie(size, data) = data.split('\n');
+    if(name.empty() || name.contains('/') || size.getAsInteger(10, length) || length > data.size())
+      return false; //damaged entry, which is treated as a miss and overwritten
+    files.push_back({name, data.take_front(length)});
+    data = data.drop_front(length);
+  }
+
+  for(auto &file : files)
+  {
+    std::error_code EC;
+    raw_fd_ostream out(file.first, EC, sys::fs::OF_None);
+    if(EC)
+    {
+      errs() << "Could not open file: " << EC.message();
+      return false;
+    }
+    out << file.second;
+  }
+  return true;
+}
+
+static void storeInCache(StringRef dir, StringRef key, StringRef warnings, const vector<string> &files, uint64_t maxSize) {
+  string entry = CacheMagic.str() + std::to_string(warnings.size()) + "\n" + warnings.str();
+  for(const string &name : files)
+  {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> file = MemoryBuffer::getFile(name);
+    if(!file)
+      return;
+    entry += name + "\n" + std::to_string((*file)->getBufferSize()) + "\n" + (*file)->getBuffer().str();
+  }
+  writeCacheEntry(dir, key, entry);
+
+  CachePruningPolicy policy;
+  policy.Interval = std::chrono::seconds(0); //check the size after every store
+  policy.Expiration = std::chrono::seconds(0); //entries are only evicted to stay within the size limit
+  policy.MaxSizeBytes = maxSize;
+  pruneCache(dir, policy); //also covers the function entries stored by this compilation
+}
+
+static void printCacheStats(StringRef dir) {
+  uint64_t entries = 0, size = 0, hits = 0, misses = 0;
+  std::error_code EC;
+  for(sys::fs::directory_iterator it(dir, EC), end; it != end && !EC; it.increment(EC))
+  {
+    ErrorOr<sys::fs::basic_file_status> status = it->status();
+    if(!status)
+      continue;
+    StringRef name = sys::path::filename(it->path());
+    if(name.startswith("llvmcache-"))
+    {
+      entries++;
+      size += status->getSize();
+    }
+    else if(name == "stats.hits")
+      hits = status->getSize();
+    else if(name == "stats.misses")
+      misses = status->getSize();
+  }
+  outs() << "Cache directory: " << dir << "\n";
+  outs() << "Entries: " << entries << "\n";
+  outs() << "Size: " << size << " bytes\n";
+  outs() << "Hits: " << hits << "\n";
+  outs() << "Misses: " << misses << "\n";
+  if(hits + misses != 0)
+    outs() << format("Hit rate: %.1f%%\n", 100.0 * hits / (hits + misses));
+}
+
+//===----------------------------------------------------------------------===//
+// AST cache - for --ast-cache
+// Lexing and parsing dominate the front end, and are repeated on every compile of an input that rarely changes. Once
+// semantic analysis has succeeded, the checked AST - with the implicit casts, the type of every expression and the
+// declaration each variable reference resolves to - is serialised to a binary file next to the source, <input>.astcache.
+// The next compile of the same source maps the file into memory and rebuilds the AST from it, without lexing,
+// parsing or semantic analysis; constant folding and code generation run as usual, so the output is the same.
+// The file starts with ASTCacheMagic, the cache key of the source and a checksum of the rest, and is rewritten when
+// the key or the checksum does not match.
+// The warnings of the parser and semantic analysis are stored too, and printed again when the file is loaded.
+//===----------------------------------------------------------------------===//
+
+static const StringRef ASTCacheMagic = "mccomp-ast\n"; //followed by the cache key, "\n", the xxHash64 of the AST, and the AST
+enum ASTCacheTag : uint8_t {GLOBAL_TAG, PROTOTYPE_TAG, FUNCTION_TAG}; //kinds of top-level nodes
+
+/// ASTWriter - serialises the AST. Integers are stored as LEB128 - token types, line and column numbers and most
+/// counts take a single byte - and each distinct string once, in a table that nodes refer to by index. Lists are
+/// stored as their length followed by their contents, and nodes as their kind and type followed by their fields. A
+/// variable reference refers to its declaration by the declaration's number within the function.
+struct ASTWriter {
+  string Data;
+  StringMap<uint32_t> StringIndices;
+  vector<StringRef> Strings; //the string table, in the order the strings were first written
+  DenseMap<const VariableASTnode*,uint32_t> Locals; //the parameters, then the local variables in the order they are declared
+
+  void writeByte(uint8_t val) { Data += char(val); }
+  void writeInt(uint64_t val) {
+    uint8_t bytes[16];
+    Data.append(reinterpret_cast<const char*>(bytes), encodeULEB128(val, bytes));
+  }
+  void writeSignedInt(int64_t val) {
+    uint8_t bytes[16];
+    Data.append(reinterpret_cast<const char*>(bytes), encodeSLEB128(val, bytes));
+  }
+  void writeFloat(float val) { Data.append(reinterpret_cast<const char*>(&val), sizeof(val)); }
+  void writeString(StringRef str) {
+    auto it = StringIndices.insert({str, Strings.size()});
+    if(it.second)
+      Strings.push_back(it.first->first());
+    writeInt(it.first->second);
+  }
+  void writeToken(const TOKEN &tok) {
+    writeSignedInt(tok.type);
+    writeString(tok.lexeme);
+    writeInt(tok.lineNo);
+    writeInt(tok.columnNo);
+  }
+  void writeNode(const ASTnode *node) {
+    if(node == nullptr)
+    {
+      writeByte(ASTnode::NumKinds);
+      return;
+    }
+    writeByte(node->getKind());
+    writeByte(node->getExprType());
+    node->serialize(*this);
+  }
+  void writeBlock(const vector<unique_ptr<ASTnode>> &block) {
+    writeInt(block.size());
+    for(const unique_ptr<ASTnode> &node : block)
+      writeNode(node.get());
+  }
+  void addLocal(const VariableASTnode *var) {
+    Locals.insert({var, Locals.size()});
+  }
+};
+
+void IntASTnode::serialize(ASTWriter &W) const {
+  W.writeToken(Tok);
+  W.writeSignedInt(Val);
+}
+
+void FloatASTnode::serialize(ASTWriter &W) const {
+  W.writeToken(Tok);
+  W.writeFloat(Val);
+}
+
+void BoolASTnode::serialize(ASTWriter &W) const {
+  W.writeToken(Tok);
+  W.writeByte(Val);
+}
+
+void VariableASTnode::serialize(ASTWriter &W) const {
+  W.writeToken(Tok);
+  W.writeString(Type);
+  W.writeString(Val);
+  W.addLocal(this);
+}
+
+//0 for a global variable, otherwise the number of the local declaration plus one
+void VariableReferenceASTnode::serialize(ASTWriter &W) const {
+  W.writeToken(Tok);
+  W.writeString(Name);
+  W.writeInt(Decl != nullptr ? W.Locals.lookup(Decl) + 1 : 0);
+  W.writeByte(IsLValue);
+}
+
+void UnaryExprASTnode::serialize(ASTWriter &W) const {
+  W.writeToken(Tok);
+  W.writeString(Opcode);
+  W.writeNode(Operand.get());
+}
+
+void BinaryExprASTnode::serialize(ASTWriter &W) const {
+  W.writeToken(Tok);
+  W.writeString(Opcode);
+  W.writeNode(LHS.get());
+  W.writeNode(RHS.get());
+}
+
+void FuncCallASTnode::serialize(ASTWriter &W) const {
+  W.writeToken(Tok);
+  W.writeString(Callee);
+  W.writeBlock(Args);
+}
+
+void ImplicitCastASTnode::serialize(ASTWriter &W) const {
+  W.writeNode(Operand.get());
+}
+
+void IfExprASTnode::serialize(ASTWriter &W) const {
+  W.writeNode(Cond.get());
+  W.writeBlock(Then);
+  W.writeBlock(Else);
+}
+
+void WhileExprASTnode::serialize(ASTWriter &W) const {
+  W.writeNode(Cond.get());
+  W.writeBlock(Then);
+}
+
+void ReturnExprASTnode::serialize(ASTWriter &W) const {
+  W.writeToken(Tok);
+  W.writeString(FuncReturnType);
+  W.writeNode(ReturnExpr.get());
+}
+
+void GlobalVariableAST::serialize(ASTWriter &W) const {
+  W.writeByte(GLOBAL_TAG);
+  W.writeToken(Tok);
+  W.writeString(Ty);
+  W.writeString(Val);
+}
+
+void PrototypeAST::serialize(ASTWriter &W) const {
+  W.writeByte(PROTOTYPE_TAG);
+  W.writeString(Name);
+  W.writeInt(Args.size());
+  for(const unique_ptr<VariableASTnode> &arg : Args)
+    W.writeNode(arg.get());
+}
+
+//the function cache keys of --incremental are written too, as they are computed from the tokens
+void FunctionAST::serialize(ASTWriter &W) const {
+  W.writeByte(FUNCTION_TAG);
+  W.Locals.clear();
+  Proto->serialize(W);
+  W.writeBlock(Body);
+  W.writeString(TokenDigest);
+  W.writeInt(Identifiers.size());
+  for(const string &name : Identifiers)
+    W.writeString(name);
+}
+
+/// ASTReader - rebuilds the AST from the contents of an AST cache file. Every read is checked against the end of the
+/// data, so a damaged file sets Failed and is treated as a miss rather than crashing the compiler
+struct ASTReader {
+  const uint8_t *Ptr, *End;
+  bool Failed = false;
+  vector<string> Strings;
+  vector<VariableASTnode*> Locals; //declarations of the function being read, numbered as by ASTWriter
+  //the globals and functions declared by the top-level nodes read so far, in source order
+  vector<GlobalVariableAST*> Globals;
+  vector<PrototypeAST*> Functions, Definitions;
+
+  ASTReader(StringRef data) : Ptr(data.bytes_begin()), End(data.bytes_end()) {}
+
+  uint8_t readByte() {
+    if(Ptr == End)
+    {
+      Failed = true;
+      return 0;
+    }
+    return *Ptr++;
+  }
+  uint64_t readInt() {
+    unsigned size;
+    const char *error = nullptr;
+    uint64_t val = decodeULEB128(Ptr, &size, End, &error);
+    Failed |= error != nullptr;
+    Ptr += size;
+    return val;
+  }
+  int64_t readSignedInt() {
+    unsigned size;
+    const char *error = nullptr;
+    int64_t val = decodeSLEB128(Ptr, &size, End, &error);
+    Failed |= error != nullptr;
+    Ptr += size;
+    return val;
+  }
+  float readFloat() {
+    float val = 0.0f;
+    if(size_t(End - Ptr) < sizeof(val))
+      Failed = true;
+    else
+    {
+      memcpy(&val, Ptr, sizeof(val));
+      Ptr += sizeof(val);
+    }
+    return val;
+  }
+  //a count of items that take at least one byte each, which cannot be more than the bytes left
+  uint32_t readCount() {
+    uint64_t count = readInt();
+    if(count > size_t(End - Ptr))
+      Failed = true;
+    return Failed ? 0 : count;
+  }
+  const string &readString() {
+    static const string empty;
+    uint64_t index = readInt();
+    if(index >= Strings.size())
+      Failed = true;
+    return Failed ? empty : Strings[index];
+  }
+  bool readStringTable() {
+    uint32_t size = readCount();
+    Strings.reserve(size);
+    for(uint32_t i = 0; i < size && !Failed; i++)
+    {
+      uint32_t length = readCount();
+      Strings.emplace_back(reinterpret_cast<const char*>(Ptr), length);
+      Ptr += length;
+    }
+    return !Failed;
+  }
+  TOKEN readToken() {
+    TOKEN tok;
+    tok.type = int(readSignedInt());
+    tok.lexeme = readString();
+    tok.lineNo = int(readInt());
+    tok.columnNo = int(readInt());
+    return tok;
+  }
+  unique_ptr<VariableASTnode> readVariable() {
+    TOKEN tok = readToken();
+    const string &type = readString();
+    const string &val = readString();
+    auto var = make_unique<VariableASTnode>(tok, type, val);
+    Locals.push_back(var.get());
+    return var;
+  }
+  bool readBlock(vector<unique_ptr<ASTnode>> &block) {
+    uint32_t size = readCount();
+    for(uint32_t i = 0; i < size && !Failed; i++)
+      block.push_back(readNode());
+    return !Failed;
+  }
+  unique_ptr<ASTnode> readNode();
+  unique_ptr<PrototypeAST> readPrototype();
+  unique_ptr<TopLevelASTnode> readTopLevelNode();
+};
+
+unique_ptr<ASTnode> ASTReader::readNode() {
+  uint8_t kind = readByte();
+  if(Failed || kind == ASTnode::NumKinds)
+    return nullptr;
+  int8_t type = readByte();
+  if(kind > ASTnode::NumKinds || type < NO_TYPE || type > VOID_TYPE)
+  {
+    Failed = true;
+    return nullptr;
   }
 
-  if(CalleeF->getReturnType()->isVoidTy())
-    return Builder.CreateCall(CalleeF, ArgsV); //void functions cannot have a name
-  else
-    return Builder.CreateCall(CalleeF, ArgsV, "call_tmp"); 
+  unique_ptr<ASTnode> node;
+  switch(kind)
+  {
+    case ASTnode::IntKind: {
+      TOKEN tok = readToken();
+      node = make_unique<IntASTnode>(tok, int(readSignedInt()));
+      break;
+    }
+    case ASTnode::FloatKind: {
+      TOKEN tok = readToken();
+      node = make_unique<FloatASTnode>(tok, readFloat());
+      break;
+    }
+    case ASTnode::BoolKind: {
+      TOKEN tok = readToken();
+      node = make_unique<BoolASTnode>(tok, readByte() != 0);
+      break;
+    }
+    case ASTnode::VariableKind:
+      node = readVariable();
+      break;
+    case ASTnode::VariableReferenceKind: {
+      TOKEN tok = readToken();
+      const string &name = readString();
+      uint32_t decl = readInt();
+      auto ref = make_unique<VariableReferenceASTnode>(tok, name);
+      if(decl > Locals.size())
+        Failed = true;
+      else if(decl != 0)
+        ref->setDecl(Locals[decl - 1]);
+      if(readByte())
+        ref->setLValue();
+      node = std::move(ref);
+      break;
+    }
+    case ASTnode::UnaryExprKind: {
+      TOKEN tok = readToken();
+      const string &op = readString();
+      unique_ptr<ASTnode> operand = readNode();
+      node = make_unique<UnaryExprASTnode>(op, std::move(operand), tok);
+      break;
+    }
+    case ASTnode::BinaryExprKind: {
+      TOKEN tok = readToken();
+      const string &op = readString();
+      unique_ptr<ASTnode> lhs = readNode();
+      unique_ptr<ASTnode> rhs = readNode();
+      node = make_unique<BinaryExprASTnode>(op, std::move(lhs), std::move(rhs), tok);
+      break;
+    }
+    case ASTnode::FuncCallKind: {
+      TOKEN tok = readToken();
+      const string &callee = readString();
+      vector<unique_ptr<ASTnode>> args;
+      readBlock(args);
+      node = make_unique<FuncCallASTnode>(callee, std::move(args), tok);
+      break;
+    }
+    case ASTnode::ImplicitCastKind: {
+      unique_ptr<ASTnode> operand = readNode();
+      node = make_unique<ImplicitCastASTnode>(std::move(operand), MiniCType(type));
+      break;
+    }
+    case ASTnode::IfExprKind: {
+      unique_ptr<ASTnode> cond = readNode();
+      vector<unique_ptr<ASTnode>> then, otherwise;
+      readBlock(then);
+      readBlock(otherwise);
+      node = make_unique<IfExprASTnode>(std::move(cond), std::move(then), std::move(otherwise));
+      break;
+    }
+    case ASTnode::WhileExprKind: {
+      unique_ptr<ASTnode> cond = readNode();
+      vector<unique_ptr<ASTnode>> then;
+      readBlock(then);
+      node = make_unique<WhileExprASTnode>(std::move(cond), std::move(then));
+      break;
+    }
+    case ASTnode::ReturnExprKind: {
+      TOKEN tok = readToken();
+      const string &returnType = readString();
+      unique_ptr<ASTnode> returnExpr = readNode();
+      node = make_unique<ReturnExprASTnode>(std::move(returnExpr), returnType, tok);
+      break;
+    }
+  }
+  node->setExprType(MiniCType(type));
+  return node;
 }
 
-Value* IfExprASTnode::codegen(){
+unique_ptr<PrototypeAST> ASTReader::readPrototype() {
+  string name = readString();
+  vector<unique_ptr<VariableASTnode>> args;
+  uint32_t size = readCount();
+  for(uint32_t i = 0; i < size && !Failed; i++)
+  {
+    if(readByte() != ASTnode::VariableKind)
+      Failed = true;
+    readByte(); //the type, which declarations do not have
+    if(!Failed)
+      args.push_back(readVariable());
+  }
+  auto proto = make_unique<PrototypeAST>(name, std::move(args));
+  Functions.push_back(proto.get());
+  return proto;
+}
 
-  bool elseExist = false;
-   if(Else.size() != 0) //no need to create else branch if there is no else block
-    elseExist = true;
-  
-  //create necessary basic block to add expressions to
-  Function* TheFunction = Builder.GetInsertBlock()->getParent();
-  BasicBlock* true_ = BasicBlock::Create(TheContext, "if_then", TheFunction);
-  BasicBlock* false_;
+unique_ptr<TopLevelASTnode> ASTReader::readTopLevelNode() {
+  uint8_t tag = readByte();
+  if(tag == FUNCTION_TAG)
+  {
+    Locals.clear();
+    if(readByte() != PROTOTYPE_TAG)
+      Failed = true;
+    unique_ptr<PrototypeAST> proto = readPrototype();
+    Definitions.push_back(proto.get());
+    vector<unique_ptr<ASTnode>> body;
+    readBlock(body);
+    string digest = readString();
+    std::set<string> identifiers;
+    uint32_t size = readCount();
+    for(uint32_t i = 0; i < size && !Failed; i++)
+      identifiers.insert(readString());
+    auto F = make_unique<FunctionAST>(std::move(proto), std::move(body));
+    F->setTokens(std::move(digest), std::move(identifiers));
+    return F;
+  }
+  else if(tag == PROTOTYPE_TAG)
+    return readPrototype();
+  else if(tag == GLOBAL_TAG)
+  {
+    TOKEN tok = readToken();
+    const string &type = readString();
+    const string &val = readString();
+    auto global = make_unique<GlobalVariableAST>(tok, type, val);
+    Globals.push_back(global.get());
+    return global;
+  }
+  Failed = true;
+  return nullptr;
+}
 
-  if(elseExist)
-    false_ = BasicBlock::Create(TheContext, "if_else", TheFunction);
+//the file holding the AST of an input
+static string getASTCachePath(StringRef inputFile) {
+  return (inputFile + ".astcache").str();
+}
 
-  BasicBlock* end_ = BasicBlock::Create(TheContext, "if_end");
-  Value* cond = Cond->codegen(); //generate condition expression
-  if(cond == nullptr)
-      return nullptr;
+//loads the AST in the file into root if it was written for the given key, and declares its globals and functions
+//for code generation as semantic analysis would. Returns false on a miss
+static bool loadASTCache(StringRef path, StringRef key) {
+  //the file is mapped rather than read, and the nodes are built straight from the mapping
+  ErrorOr<std::unique_ptr<MemoryBuffer>> file = MemoryBuffer::getFile(path, false, false);
+  if(!file)
+    return false;
+  StringRef data = (*file)->getBuffer();
+  uint64_t checksum;
+  if(!data.consume_front(ASTCacheMagic) || !data.consume_front(key) || !data.consume_front("\n") || data.size() < sizeof(checksum))
+    return false;
+  memcpy(&checksum, data.data(), sizeof(checksum));
+  data = data.drop_front(sizeof(checksum));
+  if(xxHash64(data) != checksum)
+    return false;
 
-  //check type of cond - making sure it is a bool
-  string currType = "";
-  if(auto *AI = dyn_cast<AllocaInst>(cond)) //load RHS
-  {
-    if(AI->getAllocatedType()->isFloatTy())
-    {
-      cond = Builder.CreateLoad(Type::getFloatTy(TheContext), AI, "load_temp");
-      currType = "float";
-    }
-    else if(AI->getAllocatedType()->isIntegerTy(32))
-    {
-      cond = Builder.CreateLoad(Type::getInt32Ty(TheContext), AI, "load_temp");
-      currType = "int";
-    }
-    else if(AI->getAllocatedType()->isIntegerTy(1))
-    {
-      cond = Builder.CreateLoad(Type::getInt1Ty(TheContext), AI, "load_temp");
-      currType = "bool";
-    }
-  }
-  else if(auto *GV = dyn_cast<GlobalVariable>(cond)) //if RHS is a global variable
+  ASTReader R(data);
+  Stats.Tokens = R.readInt();
+  R.readStringTable();
+  const string &warnings = R.readString();
+  uint32_t size = R.readCount();
+  for(uint32_t i = 0; i < size && !R.Failed; i++)
   {
-    if(GV->getValueType()->isFloatTy())
-    {
-      cond = Builder.CreateLoad(Type::getFloatTy(TheContext), GV, "load_temp");
-      currType = "float";
-    }
-    else if(GV->getValueType()->isIntegerTy(32))
-    {
-      cond = Builder.CreateLoad(Type::getInt32Ty(TheContext), GV, "load_temp");
-      currType = "int";
-    }
-    else if(GV->getValueType()->isIntegerTy(1))
-    {
-      cond = Builder.CreateLoad(Type::getInt1Ty(TheContext), GV, "load_temp");
-      currType = "bool";
-    }
+    unique_ptr<TopLevelASTnode> node = R.readTopLevelNode();
+    if(!R.Failed)
+      root.push_back(std::move(node));
   }
-  else
+  if(R.Failed || R.Ptr != R.End)
   {
-    if(cond->getType()->isFloatTy())
-      currType = "float";
-    else if(cond->getType()->isIntegerTy(32))
-      currType = "int";
-    else if(cond->getType()->isIntegerTy(1))
-      currType = "bool";
+    root.clear(); //damaged file, which is treated as a miss and overwritten
+    Stats.Tokens = 0;
+    std::fill(std::begin(ASTnode::NodesCreated), std::end(ASTnode::NodesCreated), 0);
+    return false;
   }
+  errs()<<"AST cache hit: loaded "<<path<<"\n"<<warnings;
+  ReportedWarnings = warnings; //for the --cache-dir entry
 
-  //make sure the condition statement is of `bool` type
-  if(currType != "bool")
-  {
-    errs()<<"Semantic error: Expected type `bool` for the condition statement at line no. "<<Cond->getTok().lineNo<<" column no. "<<Cond->getTok().columnNo<<". Cannot cast from type `"<<currType<<"` to `bool`.\n";
-    return nullptr;
-  }
+  for(GlobalVariableAST *global : R.Globals)
+    SemanticGlobals.insert({global->getVal(), global});
+  for(PrototypeAST *proto : R.Functions)
+    SemanticFunctions.insert({proto->getFunctionName(), proto}); //the first declaration, as in PrototypeAST::checkSemantics()
+  for(PrototypeAST *proto : R.Definitions)
+    SemanticDefinitions.insert(proto->getFunctionName());
+  return true;
+}
 
-  Value* comp = Builder.CreateICmpNE(cond, ConstantInt::get(TheContext, APInt(1,0,false)), "if_cond");
+//writes the AST in root, once semantic analysis has succeeded. The file is written to a temporary file and renamed
+//into place, so that a concurrent compile never maps a partial file; a source directory that cannot be written to
+//is not an error
+static void storeASTCache(StringRef path, StringRef key) {
+  ASTWriter W;
+  W.writeString(ReportedWarnings);
+  W.writeInt(root.size());
+  for(const unique_ptr<TopLevelASTnode> &node : root)
+    node->serialize(W);
+  string nodes = std::move(W.Data);
+
+  //the string table comes first, so that it has been read by the time the nodes refer to it
+  W.Data.clear();
+  W.writeInt(Stats.Tokens);
+  W.writeInt(W.Strings.size());
+  for(StringRef str : W.Strings)
+  {
+    W.writeInt(str.size());
+    W.Data += str;
+  }
+  W.Data += nodes;
+  uint64_t checksum = xxHash64(W.Data);
+
+  Expected<sys::fs::TempFile> temp = sys::fs::TempFile::create(path + ".tmp-%%%%%%%%%%%%");
+  if(!temp)
+  {
+    consumeError(temp.takeError());
+    return;
+  }
+  raw_fd_ostream out(temp->FD, false);
+  out << ASTCacheMagic << key << "\n" << StringRef(reinterpret_cast<const char*>(&checksum), sizeof(checksum)) << W.Data;
+  out.flush();
+  if(out.has_error()) //as for writeCacheEntry(), a partial file is never renamed into place
+  {
+    out.clear_error();
+    consumeError(temp->discard());
+    return;
+  }
+  if(Error E = temp->keep(path))
+    consumeError(std::move(E));
+}
 
-  //create conditional branch instruction
-  if(elseExist)
-    Builder.CreateCondBr(comp, true_, false_);
-  else
-    Builder.CreateCondBr(comp, true_, end_);
+//===----------------------------------------------------------------------===//
+// Parallel code generation - for -j N
+// Once semantic analysis has run, function bodies only depend on the declarations of the globals and functions they
+// use, so they can be generated independently. The function definitions are split into chunks of consecutive
+// functions; each chunk is generated, verified and optimised on a thread pool into its own module, in the worker's own
+// LLVMContext. The chunks are passed back as bitcode and linked into the main module in source order, so the output
+// does not depend on the number of threads or on scheduling.
+//===----------------------------------------------------------------------===//
 
-  Builder.SetInsertPoint(true_);
-  ///Then block
-  std::map<std::string, AllocaInst*> NamedValues_Then; //Creating symbol table for Then block
-  NamedValuesList.push_back(NamedValues_Then);
+/// CodegenChunk - consecutive top-level nodes root[Begin, End) whose function definitions one worker generates
+struct CodegenChunk {
+  size_t Begin, End;
+  SmallVector<char, 0> Bitcode; //the chunk's module
+  vector<FunctionStats> Functions; //for --stats
+  bool Failed = false;
+  string CacheKey = ""; //with --incremental, each chunk is one function, stored in the function cache under this key
+  bool Cached = false; //the bitcode was read from the function cache, so there is nothing to generate
+};
 
-  bool generateBranchForThen = true;
-  bool generateBranchForElse = true;
-  Value* ret;
+static void generateChunk(CodegenChunk &chunk, bool trace, unsigned traceGranularity) {
+  IsWorkerThread = true;
+  if(trace)
+    timeTraceProfilerInitialize(traceGranularity, "mccomp");
+  GeneratedFunctions = &chunk.Functions;
+  TheModule = std::make_unique<Module>("mini-c", TheContext);
+  GlobalVariables.clear();
+  if(OptLevel > 0)
+    InitializeFunctionPassManager();
+
+  for(size_t i = chunk.Begin; i < chunk.End && !chunk.Failed; i++)
+    if(root[i]->hasBody() && root[i]->codegen() == nullptr)
+      chunk.Failed = true;
+
+  if(TheFPM)
+    TheFPM->doFinalization();
+  if(!chunk.Failed)
+  {
+    raw_svector_ostream OS(chunk.Bitcode);
+    WriteBitcodeToFile(*TheModule, OS, /*ShouldPreserveUseListOrder=*/true); //keeps the functions identical to -j 1, not just equivalent
+    if(chunk.CacheKey != "")
+      writeCacheEntry(FunctionCacheDir, chunk.CacheKey, StringRef(chunk.Bitcode.data(), chunk.Bitcode.size()));
+  }
+  TheFPM.reset();
+  TheModule.reset(); //the worker's context is reused by its next chunk
+  if(trace)
+    timeTraceProfilerFinishThread(); //hands the worker's spans over to the main thread's trace
+}
 
-  for(int i = 0; i < Then.size(); i++)
+//generates every function definition with the given number of threads and links them into TheModule;
+//globals and externs are generated into TheModule first, on the main thread. With --incremental, the functions found
+//in the function cache are linked in from there instead
+static bool parallelCodegen(unsigned jobs, unsigned traceGranularity) {
+  size_t numFunctions = 0;
+  for(size_t i = 0; i < root.size(); i++)
   {
-    //new block - create a new symbol table
-    Value* thenVal = Then.at(i)->codegen();
-    if(thenVal == nullptr)
-      return nullptr;
-    if(auto *R = dyn_cast<ReturnInst>(thenVal))
-      {
-        ret = thenVal;
-        generateBranchForThen = false;
-        break; //don't generate IR for instructions after return
-      }
+    if(root[i]->hasBody())
+      numFunctions++;
+    else if(root[i]->codegen() == nullptr)
+      return false;
   }
-  //remove symbol table of Then block
-  NamedValuesList.pop_back();
-
-  if(generateBranchForThen)
-    Builder.CreateBr(end_);  //create unconditional branch instruction to end, given that `if_then` block had no return statements
+  vector<string> globalOrder; //the linker moves the globals that the chunks refer to, so they are put back in declaration order afterwards
+  for(GlobalVariable &GV : TheModule->globals())
+    globalOrder.push_back(GV.getName().str());
 
-  if(elseExist)
+  vector<CodegenChunk> chunks;
+  if(FunctionCacheDir != "")
   {
-    Builder.SetInsertPoint(false_);
-    ///Else block
-    //new block - create a new symbol table
-    std::map<std::string, AllocaInst*> NamedValues_Else; //Creating symbol table for Else block
-    NamedValuesList.push_back(NamedValues_Else);
-    for(int i = 0; i < Else.size(); i++)
+    CompilePhase phase(PHASE_CACHE);
+    for(size_t i = 0; i < root.size(); i++)
     {
-      Value* elseVal = Else.at(i)->codegen();
-      if(elseVal == nullptr)
-        return nullptr;
-      if(auto *R = dyn_cast<ReturnInst>(elseVal))
+      if(!root[i]->hasBody())
+        continue;
+      chunks.emplace_back();
+      CodegenChunk &chunk = chunks.back();
+      chunk.Begin = i;
+      chunk.End = i + 1;
+      chunk.CacheKey = getFunctionCacheKey(static_cast<const FunctionAST&>(*root[i]));
+      if(std::unique_ptr<MemoryBuffer> entry = readCacheEntry(FunctionCacheDir, chunk.CacheKey))
       {
-        ret = elseVal;
-        generateBranchForElse = false;
-        break; //don't generate IR for instructions after return
+        chunk.Bitcode.assign(entry->getBufferStart(), entry->getBufferEnd());
+        chunk.Cached = true;
+        Stats.FunctionCacheHits++;
       }
+      else
+        Stats.FunctionCacheMisses++;
     }
-
-    if(generateBranchForElse)
-      Builder.CreateBr(end_); //create unconditional branch to end if else block has no return statements
-
-    //remove symbol table of Else block
-    NamedValuesList.pop_back();
-  }
-
-  if(generateBranchForThen | generateBranchForElse) //only generate 'if_end' block if 'if_then' and 'if_else' don't have a return stmt
-  {
-    TheFunction->insert(TheFunction->end(), end_);
-    Builder.SetInsertPoint(end_);
-    return ConstantPointerNull::get(PointerType::getUnqual(Type::getVoidTy(TheContext))); //return null pointer of void type
   }
   else
-    return ret;
-}
-
-Value* WhileExprASTnode::codegen(){
-  Function* TheFunction = Builder.GetInsertBlock()->getParent();
-  BasicBlock* cond_ = BasicBlock::Create(TheContext, "while_cond", TheFunction);
-  BasicBlock* true_ = BasicBlock::Create(TheContext, "while_body", TheFunction);
-  BasicBlock* false_ = BasicBlock::Create(TheContext, "while_end");
-  Builder.CreateBr(cond_);
-  Builder.SetInsertPoint(cond_);
-
-  Value* cond = Cond->codegen(); //generate condition expression
-  if(cond == nullptr)
-      return nullptr;
-  //check type of cond - making sure it is a bool
-  string currType = "";
-  if(auto *AI = dyn_cast<AllocaInst>(cond)) //load RHS
   {
-    if(AI->getAllocatedType()->isFloatTy())
-    {
-      cond = Builder.CreateLoad(Type::getFloatTy(TheContext), AI, "load_temp");
-      currType = "float";
-    }
-    else if(AI->getAllocatedType()->isIntegerTy(32))
+    //a few chunks per thread, so a thread that gets large functions does not hold up the others
+    size_t numChunks = std::min<size_t>(numFunctions, jobs * 4);
+    chunks.resize(numChunks);
+    size_t node = 0, seen = 0;
+    for(size_t c = 0; c < numChunks; c++)
     {
-      cond = Builder.CreateLoad(Type::getInt32Ty(TheContext), AI, "load_temp");
-      currType = "int";
-    }
-    else if(AI->getAllocatedType()->isIntegerTy(1))
-    {
-      cond = Builder.CreateLoad(Type::getInt1Ty(TheContext), AI, "load_temp");
-      currType = "bool";
+      chunks[c].Begin = node;
+      size_t target = numFunctions * (c + 1) / numChunks;
+      while(node < root.size() && (seen < target || !root[node]->hasBody()))
+        seen += root[node++]->hasBody();
+      chunks[c].End = (c == numChunks - 1) ? root.size() : node;
     }
   }
-  else if(auto *GV = dyn_cast<GlobalVariable>(cond)) //if RHS is a global variable
+
+  bool trace = timeTraceProfilerEnabled();
   {
-    if(GV->getValueType()->isFloatTy())
-    {
-      cond = Builder.CreateLoad(Type::getFloatTy(TheContext), GV, "load_temp");
-      currType = "float";
-    }
-    else if(GV->getValueType()->isIntegerTy(32))
+    ThreadPool pool(hardware_concurrency(jobs));
+    for(CodegenChunk &chunk : chunks)
+      if(!chunk.Cached)
+        pool.async([&chunk, trace, traceGranularity] { generateChunk(chunk, trace, traceGranularity); });
+    pool.wait();
+  }
+
+  Linker linker(*TheModule); //one linker for all chunks, as building one scans the types of the whole module
+  for(CodegenChunk &chunk : chunks)
+  {
+    if(chunk.Failed)
+      return false;
+    Expected<std::unique_ptr<Module>> M =
+        parseBitcodeFile(MemoryBufferRef(StringRef(chunk.Bitcode.data(), chunk.Bitcode.size()), "chunk"), TheContext);
+    if(!M)
     {
-      cond = Builder.CreateLoad(Type::getInt32Ty(TheContext), GV, "load_temp");
-      currType = "int";
+      errs() << "Could not read " << (chunk.Cached ? "cached" : "generated") << " code: " << toString(M.takeError()) << "\n";
+      return false;
     }
-    else if(GV->getValueType()->isIntegerTy(1))
+    if(linker.linkInModule(std::move(*M)))
+      return false;
+    if(StatsEnabled)
+      Stats.Functions.insert(Stats.Functions.end(), chunk.Functions.begin(), chunk.Functions.end());
+  }
+
+  for(const string &name : globalOrder) //output.ll is then the same for any -j, and the same as without it
+    if(GlobalVariable *GV = TheModule->getNamedGlobal(name))
     {
-      cond = Builder.CreateLoad(Type::getInt1Ty(TheContext), GV, "load_temp");
-      currType = "bool";
+      TheModule->removeGlobalVariable(GV);
+      TheModule->insertGlobalVariable(GV);
     }
-  }
-  else
-  {
-    if(cond->getType()->isFloatTy())
-      currType = "float";
-    else if(cond->getType()->isIntegerTy(32))
-      currType = "int";
-    else if(cond->getType()->isIntegerTy(1))
-      currType = "bool";
-  }
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// Object file output - for --emit=obj
+// The native backend runs on -j N threads: splitCodeGen() splits the module into N partitions with SplitModule and
+// compiles each one with its own TargetMachine, writing output.0.o ... output.<N-1>.o. With -j 1 it writes output.o.
+//===----------------------------------------------------------------------===//
 
-  if(currType != "bool") //cast to bool type
+static std::unique_ptr<TargetMachine> createTargetMachine() {
+  string triple = sys::getDefaultTargetTriple();
+  string error;
+  const Target *target = TargetRegistry::lookupTarget(triple, error);
+  if(!target)
   {
-    errs()<<"Semantic error: Expected type `bool` for the condition statement at line no. "<<Cond->getTok().lineNo<<" column no. "<<Cond->getTok().columnNo<<". Cannot cast from type `"<<currType<<"` to `bool`.\n";
+    errs() << error << "\n";
     return nullptr;
   }
+  CodeGenOpt::Level level = (OptLevel == 0) ? CodeGenOpt::None : (OptLevel == 1) ? CodeGenOpt::Less : CodeGenOpt::Default;
+  return std::unique_ptr<TargetMachine>(target->createTargetMachine(triple, "generic", "", TargetOptions(), Reloc::PIC_, std::nullopt, level));
+}
 
-  Value* comp = Builder.CreateICmpNE(cond, ConstantInt::get(TheContext, APInt(1,0, false)), "if_cond");
-  Builder.CreateCondBr(comp, true_, false_);
-  Builder.SetInsertPoint(true_);
-  ///Then block
-  std::map<std::string, AllocaInst*> NamedValues_Then; //Creating symbol table for Then block
-  NamedValuesList.push_back(NamedValues_Then);
+//the files written by a compilation
+static vector<string> getOutputFiles(bool emitObject, unsigned jobs) {
+  if(!emitObject)
+    return {"output.ll"};
+  if(jobs == 1)
+    return {"output.o"};
+  vector<string> files;
+  for(unsigned i = 0; i < jobs; i++)
+    files.push_back("output." + std::to_string(i) + ".o");
+  return files;
+}
 
-  bool generateBranchForBody = true;
+static bool writeObjects(unsigned jobs) {
+  InitializeNativeTarget();
+  InitializeNativeTargetAsmPrinter();
+  std::unique_ptr<TargetMachine> TM = createTargetMachine();
+  if(!TM)
+    return false;
+  TheModule->setTargetTriple(TM->getTargetTriple().str());
+  TheModule->setDataLayout(TM->createDataLayout());
 
-  for(int i = 0; i < Then.size(); i++)
+  vector<std::unique_ptr<raw_fd_ostream>> files;
+  vector<raw_pwrite_stream*> streams;
+  for(const string &filename : getOutputFiles(true, jobs))
   {
-    //new block - create a new symbol table
-    Value* thenVal = Then.at(i)->codegen();
-    if(thenVal == nullptr)
-      return nullptr;
-    if(auto *R = dyn_cast<ReturnInst>(thenVal))
-      {
-        generateBranchForBody = false;
-        break; //don't generate IR for instructions after return
-      }
+    std::error_code EC;
+    files.push_back(std::make_unique<raw_fd_ostream>(filename, EC, sys::fs::OF_None));
+    if(EC)
+    {
+      errs() << "Could not open file: " << EC.message();
+      return false;
+    }
+    streams.push_back(files.back().get());
   }
-  //remove symbol table of Then block
-  if(generateBranchForBody)
-    Builder.CreateBr(cond_); //if body doesn't contain return statement, make unconditional jump to cond branch
-  NamedValuesList.pop_back();
 
-  TheFunction->insert(TheFunction->end(), false_);
-  Builder.SetInsertPoint(false_);
-  return ConstantPointerNull::get(PointerType::getUnqual(Type::getVoidTy(TheContext))); //return null pointer of void type
- 
+  splitCodeGen(*TheModule, streams, {}, createTargetMachine);
+  return true;
 }
 
-Value* ReturnExprASTnode::codegen(){
-  if(ReturnExpr == nullptr)
-  {
-    return Builder.CreateRetVoid();
-  }
-  Value* returnExpr = ReturnExpr->codegen();
+//===----------------------------------------------------------------------===//
+// AST Printer
+//===----------------------------------------------------------------------===//
 
-  if(returnExpr == nullptr)
-    return nullptr;
+static bool PrintAST = true; //cleared by -fno-print-ast - the printout grows with the square of the nesting depth
 
-  //create load
-  if(auto *AI = dyn_cast<AllocaInst>(returnExpr))
-  {
-    returnExpr = Builder.CreateLoad(AI->getAllocatedType(),returnExpr,"load_temp");
-  }
-  else if(auto *GV = dyn_cast<GlobalVariable>(returnExpr))
-  {
-    returnExpr = Builder.CreateLoad(GV->getValueType(),returnExpr,"load_global_temp");
-  }
+inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
+                                     const unique_ptr<TopLevelASTnode> &ast) { 
+  os << ast->to_string(); 
+  return os;
+}
 
-  string correctType = FuncReturnType;
-  string actualType = "";
-  if(returnExpr->getType()->isIntegerTy(32))
-    actualType = "int";
-  else if(returnExpr->getType()->isIntegerTy(1))
-    actualType = "bool";
-  else if(returnExpr->getType()->isFloatTy())
-    actualType = "float";
-  
-  //if type of return statement not correct, try to do widening conversion, otherwise error
-  if(correctType != actualType)
+//===----------------------------------------------------------------------===//
+// Streaming compilation - for --stream
+// Mini-C requires names to be declared before they are used, so each top-level declaration can be checked, folded,
+// generated and printed as soon as the parser has built it, with the same results as running each step over the
+// whole program. Afterwards only the prototype of a function definition is needed, by later calls, so its body is
+// freed. With --emit=llvm the function's IR is also written to output.ll straight away and deleted from the module,
+// leaving a declaration. Peak memory is then bounded by the largest function rather than the whole program.
+//===----------------------------------------------------------------------===//
+
+static bool StreamSema = true; //cleared by -fsyntax-only
+static bool StreamCodegen = true; //cleared by -fsyntax-only and --check
+static raw_fd_ostream *StreamOutput = nullptr; //output.ll, or nullptr with --emit=obj, which needs the whole module
+static bool StreamFailed = false; //a declaration failed semantic analysis or code generation
+static size_t StreamedNodes = 0; //root[0, StreamedNodes) have been compiled
+static std::set<const Function*> StreamedFunctions; //definitions already written to StreamOutput
+static bool StreamedGlobalLast = false; //consecutive globals are not separated by blank lines, as in Module::print()
+
+static bool streamTopLevelNodes() {
+  if(StreamFailed)
+    return false;
+  for(; StreamedNodes < root.size(); StreamedNodes++)
   {
-    if(actualType == "float")
-    {
-      errs()<<"Semantic Error: Incorrect return type `"<<actualType<<"` used in line no: "<<Tok.lineNo<<" column no: "<<Tok.columnNo<<". Cannot cast to expected return type `"<<correctType<<"`.\n";
-      return nullptr;
-    }
-    else if(actualType == "int")
+    unique_ptr<TopLevelASTnode> &node = root[StreamedNodes];
+    if(StreamSema)
     {
-      if(correctType == "float")
       {
-        errs()<<"Warning: Incorrect return type `"<<actualType<<"` used in line no: "<<Tok.lineNo<<" column no: "<<Tok.columnNo<<". Casting to expected return type `"<<correctType<<"`.\n";
-        returnExpr = Builder.CreateCast(Instruction::SIToFP,returnExpr,Type::getFloatTy(TheContext),"itof_cast");
+      CompilePhase phase(PHASE_SEMA);
+      if(!node->checkSemantics())
+      {
+        errs()<<"Semantic analysis failed.\n";
+        StreamFailed = true;
+        return false;
       }
-      else //bool
+      }
+      if(foldingEnabled)
       {
-        errs()<<"Semantic Error: Incorrect return type `"<<actualType<<"` used in line no: "<<Tok.lineNo<<" column no: "<<Tok.columnNo<<". Cannot cast to expected return type `"<<correctType<<"`.\n";
-        return nullptr;
+        CompilePhase phase(PHASE_FOLD);
+        node->foldConstants();
       }
     }
-    else if(actualType == "bool")
+
+    if(StreamCodegen)
     {
-      if(correctType == "float")
+      Value *V;
+      {
+      CompilePhase phase(PHASE_CODEGEN, "", false); //functions add their own spans to the trace
+      V = node->codegen();
+      }
+      if(V == nullptr)
+      {
+        errs()<<"IR code generation failed.\n";
+        StreamFailed = true;
+        return false;
+      }
+      if(PrintAST)
       {
-        errs()<<"Warning: Incorrect return type `"<<actualType<<"` used in line no: "<<Tok.lineNo<<" column no: "<<Tok.columnNo<<". Casting to expected return type `"<<correctType<<"`.\n";
-        returnExpr = Builder.CreateIntCast(returnExpr, Type::getInt32Ty(TheContext), false);
-        returnExpr = Builder.CreateCast(Instruction::SIToFP,returnExpr,Type::getFloatTy(TheContext),"btof_cast");
+      CompilePhase phase(PHASE_PRINT_AST);
+      llvm::outs() << "|\n|-> " << node << "\n";
       }
-      else //int
+      if(StreamOutput != nullptr)
       {
-        errs()<<"Warning: Incorrect return type `"<<actualType<<"` used in line no: "<<Tok.lineNo<<" column no: "<<Tok.columnNo<<". Casting to expected return type `"<<correctType<<"`.\n";
-        returnExpr = Builder.CreateIntCast(returnExpr, Type::getInt32Ty(TheContext), false, "btoi_cast");
+        CompilePhase phase(PHASE_OUTPUT);
+        if(node->hasBody())
+        {
+          Function *F = cast<Function>(V);
+          *StreamOutput << "\n";
+          F->print(*StreamOutput);
+          F->deleteBody();
+          StreamedFunctions.insert(F);
+          StreamedGlobalLast = false;
+        }
+        else if(GlobalVariable *G = dyn_cast<GlobalVariable>(V))
+        {
+          if(!StreamedGlobalLast)
+            *StreamOutput << "\n";
+          G->print(*StreamOutput);
+          *StreamOutput << "\n";
+          StreamedGlobalLast = true;
+        }
       }
     }
+
+    if(node->hasBody())
+      static_cast<FunctionAST&>(*node).releaseBody();
   }
+  return true;
+}
 
-  return Builder.CreateRet(returnExpr);
+//writes the functions that are only declared, which follow the definitions as in Module::print(); the generated
+//code has no attribute groups or metadata, which would otherwise have to be written here as well
+static void finishStreamOutput() {
+  for(const Function &F : *TheModule)
+    if(StreamedFunctions.count(&F) == 0)
+    {
+      *StreamOutput << "\n";
+      F.print(*StreamOutput);
+    }
 }
 
-Function* PrototypeAST::codegen(){
-  // Make the function type:
-  string ReturnType = "";
-  string origName = getName();
-  size_t space_pos = origName.find(" ");    
+//===----------------------------------------------------------------------===//
+// Statistics output - for --stats and --stats-json
+//===----------------------------------------------------------------------===//
+
+static void printStat(raw_ostream &OS, unsigned long value, const char *group, const Twine &description)
+{
+  OS << format("%10lu %-8s - ", value, group) << description << "\n";
+}
+
+static void printStats(raw_ostream &OS)
+{
+  OS << "===" << std::string(73, '-') << "===\n";
+  OS << "                          ... Statistics Collected ...\n";
+  OS << "===" << std::string(73, '-') << "===\n\n";
+
+  printStat(OS, Stats.Tokens, "lexer", "Tokens lexed");
+  printStat(OS, Stats.Expressions, "parser", "Expressions built by createExprASTnode");
+  printStat(OS, Stats.ExpressionTokens, "parser", "Tokens in those expressions");
+  printStat(OS, Stats.MaxExpressionTokens, "parser", "Tokens in the longest expression");
+  for(int i = 0; i < ASTnode::NumKinds; i++)
+    printStat(OS, ASTnode::NodesCreated[i], "ast", Twine(ASTnodeKindNames[i]) + " nodes created");
+  printStat(OS, Stats.VariableLookups, "sema", "Variable lookups");
+  printStat(OS, Stats.ScopesSearched, "sema", "Symbol tables searched by variable lookups");
+  printStat(OS, Stats.FunctionLookups, "sema", "Function lookups");
+  printStat(OS, Stats.MaxScopeDepth, "sema", "Maximum scope depth");
 
-  //string manipulation to get 'type' and 'name'
-  if (space_pos != std::string::npos) 
+  //IR size - totals, and the largest function (the JSON output lists every function)
+  unsigned long blocks = 0, instructions = 0, optBlocks = 0, optInstructions = 0;
+  const FunctionStats *largest = nullptr;
+  for(const FunctionStats &F : Stats.Functions)
   {
-    ReturnType = origName.substr(0, space_pos);
+    blocks += F.Blocks;
+    instructions += F.Instructions;
+    optBlocks += F.OptBlocks;
+    optInstructions += F.OptInstructions;
+    if(largest == nullptr || F.Instructions > largest->Instructions)
+      largest = &F;
+  }
+  printStat(OS, Stats.Functions.size(), "codegen", "Functions generated");
+  printStat(OS, blocks, "codegen", "Basic blocks generated");
+  printStat(OS, instructions, "codegen", "IR instructions generated");
+  if(largest != nullptr)
+  {
+    printStat(OS, largest->Blocks, "codegen", "Basic blocks in the largest function (" + largest->Name + ")");
+    printStat(OS, largest->Instructions, "codegen", "IR instructions in the largest function (" + largest->Name + ")");
+  }
+  if(OptLevel > 0)
+  {
+    printStat(OS, optBlocks, "opt", "Basic blocks after optimisation");
+    printStat(OS, optInstructions, "opt", "IR instructions after optimisation");
+  }
+  if(FunctionCacheDir != "")
+  {
+    printStat(OS, Stats.FunctionCacheHits, "cache", "Functions reused from the function cache");
+    printStat(OS, Stats.FunctionCacheMisses, "cache", "Functions not in the function cache");
+  }
+
+  if(LazyBodies)
+  {
+    printStat(OS, Stats.LazyBodiesParsed, "parser", "Function bodies parsed with --lazy-bodies");
+    printStat(OS, Stats.LazyBodiesDropped, "parser", "Function definitions dropped with --lazy-bodies");
+  }
+
+  for(int i = 0; i < NUM_PHASES; i++)
+    if(Stats.PhaseRSS[i] != 0)
+      printStat(OS, Stats.PhaseRSS[i], "memory", Twine("Largest RSS (KB) at the end of: ") + PhaseNames[i][1]);
+  printStat(OS, getPeakRSS(), "memory", "Peak RSS (KB) of the whole compile");
+  OS << "\n";
+}
+
+static void writeStatsJSON(raw_ostream &OS)
+{
+  json::OStream J(OS, 2);
+  J.object([&] {
+    J.attribute("tokens", int64_t(Stats.Tokens));
+    J.attributeObject("expressions", [&] {
+      J.attribute("count", int64_t(Stats.Expressions));
+      J.attribute("tokens", int64_t(Stats.ExpressionTokens));
+      J.attribute("maxTokens", int64_t(Stats.MaxExpressionTokens));
+    });
+    J.attributeObject("astNodesCreated", [&] {
+      for(int i = 0; i < ASTnode::NumKinds; i++)
+        J.attribute(ASTnodeKindNames[i], int64_t(ASTnode::NodesCreated[i]));
+    });
+    J.attributeObject("symbolTables", [&] {
+      J.attribute("variableLookups", int64_t(Stats.VariableLookups));
+      J.attribute("scopesSearched", int64_t(Stats.ScopesSearched));
+      J.attribute("functionLookups", int64_t(Stats.FunctionLookups));
+      J.attribute("maxScopeDepth", int64_t(Stats.MaxScopeDepth));
+    });
+    J.attribute("optLevel", OptLevel);
+    J.attributeArray("functions", [&] {
+      for(const FunctionStats &F : Stats.Functions)
+        J.object([&] {
+          J.attribute("name", F.Name);
+          J.attribute("blocks", F.Blocks);
+          J.attribute("instructions", F.Instructions);
+          J.attribute("optBlocks", F.OptBlocks);
+          J.attribute("optInstructions", F.OptInstructions);
+        });
+    });
+    if(FunctionCacheDir != "")
+      J.attributeObject("functionCache", [&] {
+        J.attribute("hits", int64_t(Stats.FunctionCacheHits));
+        J.attribute("misses", int64_t(Stats.FunctionCacheMisses));
+      });
+    if(LazyBodies)
+      J.attributeObject("lazyBodies", [&] {
+        J.attribute("parsed", int64_t(Stats.LazyBodiesParsed));
+        J.attribute("dropped", int64_t(Stats.LazyBodiesDropped));
+      });
+    J.attributeObject("rssAtPhaseEndKB", [&] {
+      for(int i = 0; i < NUM_PHASES; i++)
+        if(Stats.PhaseRSS[i] != 0)
+          J.attribute(PhaseNames[i][0], int64_t(Stats.PhaseRSS[i]));
+    });
+    J.attribute("peakRSSKB", int64_t(getPeakRSS()));
+  });
+  OS << "\n";
+}
+
+//===----------------------------------------------------------------------===//
+// Main driver code.
+//===----------------------------------------------------------------------===//
+
+//writes the reports asked for on the command line, once the compile has succeeded
+static int finishCompile(bool timeReport, bool printStatsReport, const string &statsJSONFile, const string &timeTraceFile) {
+  if(timeReport)
+  {
+    PhaseTimerGroup->print(errs(), true);
+    if(ExprBuildTime.count() != 0)
+      errs() << format("  Of the parsing time, %.4f seconds (wall clock) were spent building expression ASTs\n\n",
+                       std::chrono::duration<double>(ExprBuildTime).count());
+    reportAndResetTimings(&errs());
+  }
+
+  if(printStatsReport)
+    printStats(errs());
+
+  if(statsJSONFile != "")
+  {
+    std::error_code EC;
+    raw_fd_ostream statsFile(statsJSONFile, EC, sys::fs::OF_Text);
+    if (EC)
+      errs() << "Could not open file: " << EC.message();
+    else
+      writeStatsJSON(statsFile);
+  }
+
+  if(timeTraceFile != "")
+  {
+    std::error_code EC;
+    raw_fd_ostream traceFile(timeTraceFile, EC, sys::fs::OF_Text);
+    if (EC)
+      errs() << "Could not open file: " << EC.message();
+    else
+      timeTraceProfilerWrite(traceFile);
+    timeTraceProfilerCleanup();
   }
 
-  origName = origName.substr(space_pos + 1);
+  fclose(pFile); // close the file that contains the code that was parsed
+  return 0;
+}
 
-  if(ReturnType == "extern") //for extern functions, get 'extern' out from the name
-  {
-    size_t space_pos_2 = origName.find(" ");    
-    if (space_pos_2 != std::string::npos) 
+//compiles one file, given the command line without --server; returns the exit code
+static int compile(int argc, char **argv) {
+  const char *inputFile = nullptr;
+  bool timeReport = false;
+  string timeTraceFile = "";
+  unsigned timeTraceGranularity = 0; //in microseconds - shorter spans are left out of the trace
+  bool printStatsReport = false;
+  string statsJSONFile = "";
+  unsigned jobs = 1; //threads for code generation, and for parsing function bodies with -fparallel-parse
+  bool emitObject = false;
+  string cacheDir = "";
+  uint64_t cacheMaxSize = 1 << 30;
+  bool cacheStats = false;
+  bool incremental = false;
+  bool astCache = false;
+  bool syntaxOnly = false; //-fsyntax-only: stop after parsing
+  bool checkOnly = false; //--check: stop after semantic analysis and constant folding
+  std::unique_ptr<raw_fd_ostream> streamFile; //output.ll with --stream
+  for(int i = 1; i < argc; i++) //read optimisation flags and the input file name
+  {
+    string arg = argv[i];
+    if(arg == "-O0")
+      OptLevel = 0;
+    else if(arg == "-O1")
+      OptLevel = 1;
+    else if(arg == "-O2")
+      OptLevel = 2;
+    else if(arg == "-fno-fold")
+      foldingEnabled = false;
+    else if(arg == "--time-report")
+      timeReport = true;
+    else if(arg.rfind("--time-trace=", 0) == 0)
+      timeTraceFile = arg.substr(13);
+    else if(arg.rfind("--time-trace-granularity=", 0) == 0)
+      timeTraceGranularity = atoi(arg.substr(25).c_str());
+    else if(arg == "--stats")
+      printStatsReport = true;
+    else if(arg == "--stats-json")
+      statsJSONFile = "stats.json";
+    else if(arg.rfind("--stats-json=", 0) == 0)
+      statsJSONFile = arg.substr(13);
+    else if(arg == "--emit=llvm")
+      emitObject = false;
+    else if(arg == "--emit=obj")
+      emitObject = true;
+    else if(arg.rfind("--cache-dir=", 0) == 0)
+      cacheDir = arg.substr(12);
+    else if(arg.rfind("--cache-max-size=", 0) == 0)
+    {
+      char *suffix;
+      cacheMaxSize = strtoull(arg.c_str() + 17, &suffix, 10);
+      cacheMaxSize <<= (*suffix == 'k') ? 10 : (*suffix == 'm') ? 20 : (*suffix == 'g') ? 30 : 0;
+    }
+    else if(arg == "--cache-stats")
+      cacheStats = true;
+    else if(arg == "--incremental")
+      incremental = true;
+    else if(arg == "--ast-cache")
+      astCache = true;
+    else if(arg == "-fsyntax-only")
+      syntaxOnly = true;
+    else if(arg == "--check")
+      checkOnly = true;
+    else if(arg == "--stream")
+      Streaming = true;
+    else if(arg == "-fno-print-ast")
+      PrintAST = false;
+    else if(arg == "--lazy-bodies")
+    {
+      LazyBodies = true;
+      LazyRoots = {"main"};
+    }
+    else if(arg.rfind("--lazy-bodies=", 0) == 0)
+    {
+      LazyBodies = true;
+      SmallVector<StringRef, 4> names;
+      StringRef(arg).substr(14).split(names, ',', -1, false);
+      for(StringRef name : names)
+        LazyRoots.insert(name.str());
+    }
+    else if(arg == "-fparallel-parse")
+      ParallelParse = true;
+    else if(arg.rfind("-ferror-limit=", 0) == 0)
+      ErrorLimit = std::max(0, atoi(arg.substr(14).c_str()));
+    else if(arg == "-j" && i + 1 < argc)
+      jobs = std::max(1, atoi(argv[++i]));
+    else if(arg.rfind("-j", 0) == 0 && arg.size() > 2)
+      jobs = std::max(1, atoi(arg.substr(2).c_str()));
+    else if(arg[0] != '-' && inputFile == nullptr)
+      inputFile = argv[i];
+    else
     {
-      ReturnType = origName.substr(0, space_pos_2);
-      origName = origName.substr(space_pos_2 + 1);
+      inputFile = nullptr;
+      break;
     }
   }
 
-  string ArgType = "";
-  vector<Type *> ArgTypes;
-
-  for(int i = 0; i < Args.size(); i++)
+  if(cacheStats && cacheDir != "" && inputFile == nullptr)
   {
-      ArgType = Args.at(i)->getType();
-      if(ArgType == "int")
-        ArgTypes.push_back(Type::getInt32Ty(TheContext));
-      else if(ArgType == "float")
-        ArgTypes.push_back(Type::getFloatTy(TheContext));
-      else if(ArgType == "bool")
-        ArgTypes.push_back(Type::getInt1Ty(TheContext));  //bool is Int1 type
-      //ignoring void arguments - not allowed to be part of list
+    printCacheStats(cacheDir);
+    return 0;
   }
 
-  FunctionType *FT;
+  if (inputFile != nullptr) {
+    pFile = fopen(inputFile, "r");
+    if (pFile == NULL) {
+      perror("Error opening file");
+      return 1;
+    }
+  } else {
+    std::cout << "Usage: ./code [-O0|-O1|-O2] [-fno-fold] [--time-report] [--time-trace=<file>] [--time-trace-granularity=<us>] [--stats] [--stats-json[=<file>]] [--emit=llvm|obj] [-j N] [--cache-dir=<dir>] [--cache-max-size=<size>[k|m|g]] [--cache-stats] [--incremental] [--ast-cache] [-fsyntax-only|--check] [--stream] [-fno-print-ast] [-ferror-limit=N] [--lazy-bodies[=<functions>]] [-fparallel-parse] InputFile\n";
+    std::cout << "       ./code --server[=<socket>]\n";
+    return 1;
+  }
 
-  if(ReturnType == "int")
+  if(incremental && cacheDir == "")
   {
-    FT = FunctionType::get(Type::getInt32Ty(TheContext), ArgTypes, false);
+    errs() << "--incremental requires --cache-dir\n";
+    return 1;
   }
-  else if(ReturnType == "float")
+  if(incremental && Streaming)
   {
-    FT = FunctionType::get(Type::getFloatTy(TheContext), ArgTypes, false);
+    errs() << "--incremental cannot be used with --stream\n";
+    return 1;
   }
-  else if(ReturnType == "bool")
+  if(LazyBodies && Streaming)
   {
-    FT = FunctionType::get(Type::getInt1Ty(TheContext), ArgTypes, false);
+    errs() << "--lazy-bodies cannot be used with --stream\n";
+    return 1;
   }
-  else if(ReturnType == "void")
+  if(ParallelParse && Streaming)
   {
-    FT = FunctionType::get(Type::getVoidTy(TheContext), ArgTypes, false);
+    errs() << "-fparallel-parse cannot be used with --stream\n";
+    return 1;
   }
-
- Function *F = Function::Create(FT, Function::ExternalLinkage, origName, TheModule.get());
- //Set names for all arguments.
- unsigned Idx = 0;
- for (auto &Arg : F->args())
- {
-   Arg.setName(getArgName(Idx));
-   Idx++;
- }
-
- return F;
-}
-
-Value* GlobalVariableAST::codegen(){
-  bool isConstant = false; 
-  string ty = getType();
-  int alignSize = 4; //set correct alignment
-  Type* t = nullptr;
-
-  //get type of global variable
-  if(ty == "int")
-    t = Type::getInt32Ty(TheContext);
-  else if(ty == "float")
-    t = Type::getFloatTy(TheContext);
-  else if(ty == "bool")
+  if(astCache && Streaming)
   {
-    t = Type::getInt1Ty(TheContext);
-    alignSize = 1;
+    errs() << "--ast-cache cannot be used with --stream\n";
+    return 1;
   }
-  else
-    return nullptr;
-
-  //create new global variable and set name
-  GlobalVariable* g = new GlobalVariable(*(TheModule.get()),t,isConstant,GlobalValue::CommonLinkage,Constant::getNullValue(t));
-  g->setAlignment(MaybeAlign(alignSize));
-  g->setName(Val);
 
-  //add global variable to global symbol table, if it is new
-  if(GlobalVariables.insert({Val,g}).second == false)
+  if(timeReport)
   {
-    string existTy = "";
-    if(GlobalVariables[Val]->getValueType()->isIntegerTy(32))
-      existTy = "int";
-    else if(GlobalVariables[Val]->getValueType()->isIntegerTy(1))
-      existTy = "bool";
-    else if(GlobalVariables[Val]->getValueType()->isFloatTy())
-      existTy = "float";
-    
-    errs()<<"Semantic error: Redefinition of global variable "<<Val<<" with different type "<<ty<<" at line no. "<<Tok.lineNo<<" column no. "<<Tok.columnNo<<". Variable "<<Val<<" of type "<<existTy<<" already exists.\n";
-    return nullptr;
+    InitializePhaseTimers();
+    TimePassesIsEnabled = true; //LLVM also reports the time of each optimisation pass
   }
-  return g;
-}
-
-Function* FunctionAST::codegen(){
-  Function *TheFunction = TheModule->getFunction(Proto->getName());
-
-if (!TheFunction)
-  TheFunction = Proto->codegen();
-if (!TheFunction)
-  return nullptr;
- BasicBlock *BB = BasicBlock::Create(TheContext, "entry", TheFunction);
- Builder.SetInsertPoint(BB);
- // Record the function arguments in the NamedValues map.
- std::map<std::string, AllocaInst*> NamedValues;
-
- for (auto &Arg : TheFunction->args()) //loading each argument in the symbol table
- {
-    string type = "";
-    if(Arg.getType()->isIntegerTy(32))
-      type = "int";
-    if(Arg.getType()->isFloatTy())
-      type = "float";
-    else if(Arg.getType()->isIntegerTy(1))
-      type = "bool";
-      
-    AllocaInst *Alloca = CreateEntryBlockAlloca(TheFunction, Arg.getName().str(), type); //creating an alloca for each argument
-    Builder.CreateStore(&Arg, Alloca);
-    NamedValues[std::string(Arg.getName())] = Alloca;
- }
-  
- NamedValuesList.push_back(NamedValues);
+  if(timeTraceFile != "")
+    timeTraceProfilerInitialize(timeTraceGranularity, argv[0]); //the optimisation passes add their own spans to the trace
+  StatsEnabled = printStatsReport | (statsJSONFile != "");
 
- string returnType = "";
- bool returnSet = false;
-  if(TheFunction->getReturnType()->isIntegerTy(32))
-    returnType = "int"; //    returnType = "int (i32)";
-  else if(TheFunction->getReturnType()->isIntegerTy(1))
-    returnType = "bool"; // returnType = "bool (i1)";
-  else if(TheFunction->getReturnType()->isFloatTy())
-    returnType = "float"; //    returnType = "float (float)";
-  else if(TheFunction->getReturnType()->isVoidTy())
-    returnType = "void";
-
-if(Body.size() == 0)//empty function body
-{
-  if(!(TheFunction->getReturnType()->isVoidTy()))
+  //with --cache-dir, the output of an input that has been compiled before with the same flags is reused
+  string cacheKey = "";
+  if(cacheDir != "" && !syntaxOnly && !checkOnly) //the checking modes write no output to cache
+  {
+    bool hit = false;
+    string warnings;
     {
-      errs()<<"Semantic Error: Return statement of type  "<<returnType<<"  expected in function: "<<Proto->getName()<<".\n";
-      return nullptr;
+    CompilePhase phase(PHASE_CACHE);
+    ErrorOr<std::unique_ptr<MemoryBuffer>> source = MemoryBuffer::getFile(inputFile);
+    if(source && !sys::fs::create_directories(cacheDir))
+    {
+      string flags = "-O" + std::to_string(OptLevel) + (foldingEnabled ? "" : " -fno-fold") +
+                     (emitObject ? " --emit=obj -j " + std::to_string(jobs) : " --emit=llvm") + //one object file per -j partition
+                     (incremental ? " --incremental" : "") + //the module is linked together, like with -j
+                     (Streaming ? " --stream" : ""); //output.ll is written in source order
+      if(LazyBodies) //the functions that are kept
+        for(const string &name : LazyRoots)
+          flags += " --lazy-bodies=" + name;
+      cacheKey = getCacheKey((*source)->getBuffer(), flags);
+      hit = restoreFromCache(cacheDir, cacheKey, warnings);
+      countCacheLookup(cacheDir, hit);
+      if(incremental)
+        FunctionCacheDir = cacheDir;
+    }
+    }
+    if(hit)
+    {
+      errs() << "Cache hit: output restored from " << cacheDir << "\n" << warnings;
+      return finishCompile(timeReport, printStatsReport, statsJSONFile, timeTraceFile); //the reports still cover the lookup
     }
-  else
-  {
-    Builder.CreateRetVoid();
-    returnSet = true;
   }
-}
-
-for(int i = 0; i < Body.size(); i++)
-{
-  if(returnSet) //do not generate further instructions after the return statement
-    break;
 
-  Value *RetVal = Body.at(i)->codegen(); //go through all ASTnodes in this function body and run codegen() for each ASTnode
-  if(!RetVal)
-  {
-    return nullptr;
-  }
-  
-  if((i == Body.size()-1) | isa<ReturnInst>(RetVal)) //check last ASTnode of function body or check for a return expression that has been made in the body early
+  //with --ast-cache, the checked AST of a source that has been compiled before is loaded instead of parsing it again
+  string astCachePath = "", astCacheKey = "";
+  bool astLoaded = false;
+  if(astCache)
   {
-      if(auto RT = dyn_cast<ReturnInst>(RetVal)) //if last statement is a return statement
-      {
-        returnSet = true; //make sure last line is a return stmt
-      }
-      else if((i == Body.size()-1) & (returnType == "void"))
-      {
-        Builder.CreateRetVoid();
-        returnSet = true;
-      }
-      else //return statement not found
-      {
-        errs()<<"Semantic Error: Return statement of type `"<<returnType<<"` expected in function: "<<Proto->getName()<<".\n";
-        return nullptr;
-      }
-  }
-}
-
-// Validate the generated code, checking
-//for consistency.
- verifyFunction(*TheFunction);
-
- NamedValuesList.pop_back(); //remove NamedValues of this function from the vector
-
- return TheFunction;
-}
-
-//===----------------------------------------------------------------------===//
-// AST Printer
-//===----------------------------------------------------------------------===//
-
-inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
-                                     const unique_ptr<TopLevelASTnode> &ast) { 
-  os << ast->to_string(); 
-  return os;
-}
-
-//===----------------------------------------------------------------------===//
-// Main driver code.
-//===----------------------------------------------------------------------===//
-
-int main(int argc, char **argv) {
-  if (argc == 2) {
-    pFile = fopen(argv[1], "r");
-    if (pFile == NULL)
-      perror("Error opening file");
-  } else {
-    std::cout << "Usage: ./code InputFile\n";
-    return 1;
+    CompilePhase phase(PHASE_CACHE, "AST cache");
+    ErrorOr<std::unique_ptr<MemoryBuffer>> source = MemoryBuffer::getFile(inputFile);
+    if(source)
+    {
+      string flags = "--ast-cache";
+      if(FunctionCacheDir != "") //the function cache keys are only recorded with --incremental
+        flags += " --incremental";
+      if(LazyBodies) //the functions that are kept
+        for(const string &name : LazyRoots)
+          flags += " --lazy-bodies=" + name;
+      astCachePath = getASTCachePath(inputFile);
+      astCacheKey = getCacheKey((*source)->getBuffer(), flags);
+      astLoaded = loadASTCache(astCachePath, astCacheKey);
+    }
   }
 
   // initialize line number and column numbers to zero
   lineNo = 1;
   columnNo = 1;
 
+  if(!astLoaded)
+  {
+  CompilePhase phase(PHASE_LEX_VALIDATE);
   //get the first token
   getNextToken();
   //start lexical analysis - identify any invalid tokens before starting the parser
@@ -4406,42 +6495,150 @@ int main(int argc, char **argv) {
     }
     //print each token
     //fprintf(stderr, "Token: %s with type %d\n", CurTok.lexeme.c_str(),CurTok.type);
+    Stats.Tokens++;
     getNextToken();
   }
-  fprintf(stderr, "Lexer Finished.\n");
+  }
+  if(!astLoaded)
+    fprintf(stderr, "Lexer Finished.\n");
   clearTokBuffer(); //clear token buffer before re-reading file and starting parsing
 
-  // Make the module, which holds all the code.
-  TheModule = std::make_unique<Module>("mini-c", TheContext);
-
   //read file from beginning
   fseek(pFile,0,SEEK_SET);
 
   lineNo = 1;
   columnNo = 1;
 
+  if(Streaming)
+  {
+    StreamSema = !syntaxOnly;
+    StreamCodegen = !syntaxOnly && !checkOnly;
+  }
+  if(Streaming && StreamCodegen)
+  {
+    TheModule = std::make_unique<Module>("mini-c", TheContext);
+    if(OptLevel > 0)
+      InitializeFunctionPassManager();
+    if(!emitObject)
+    {
+      std::error_code EC;
+      streamFile = std::make_unique<raw_fd_ostream>("output.ll", EC, sys::fs::OF_None);
+      if(EC)
+      {
+        errs() << "Could not open file: " << EC.message();
+        return 1;
+      }
+      StreamOutput = streamFile.get();
+      TheModule->print(*StreamOutput, nullptr); //the header, as the module is still empty
+    }
+    if(PrintAST)
+    {
+      llvm::outs() << "\nPrinting out AST:"<< "\n\n";
+      llvm::outs() << "root"<< "\n";
+    }
+  }
+
+  if(!astLoaded)
+  {
+  CompilePhase phase(PHASE_PARSE);
+  LexPhase = PHASE_LEX; //from now on, lexing is done on demand by the parser
+  RecordTokens = FunctionCacheDir != ""; //the function cache keys are computed from the tokens
   //skip EOF
   getNextToken();
   // Run the parser now.
-  if(!parser())
+  if(!parser(jobs, timeTraceGranularity) || (Streaming && !streamTopLevelNodes()))
   {
-    cout<<"Parsing failed."<<endl;
+    if(!StreamFailed)
+      cout<<"Parsing failed."<<endl;
+    if(streamFile)
+    {
+      streamFile.reset();
+      sys::fs::remove("output.ll"); //incomplete
+    }
     return 1;
   }
   //fprintf(stderr, "Parsing Finished\n");
+  }
+
+  if(syntaxOnly)
+    return finishCompile(timeReport, printStatsReport, statsJSONFile, timeTraceFile);
+
+  //resolve names and types for the whole program before generating any code - a loaded AST has already been checked
+  if(!Streaming && !astLoaded)
+  {
+  CompilePhase phase(PHASE_SEMA);
+  for(int i = 0; i < root.size(); i++)
+  {
+    if(!root[i]->checkSemantics())
+    {
+      errs()<<"Semantic analysis failed.\n";
+      return 1;
+    }
+  }
+  }
+
+  if(astCacheKey != "" && !astLoaded)
+  {
+    CompilePhase phase(PHASE_CACHE, "AST cache");
+    storeASTCache(astCachePath, astCacheKey);
+  }
+
+  //fold constant subexpressions, now that every expression has a type
+  if(foldingEnabled && !Streaming)
+  {
+    CompilePhase phase(PHASE_FOLD);
+    for(int i = 0; i < root.size(); i++)
+      root[i]->foldConstants();
+  }
+
+  if(checkOnly)
+    return finishCompile(timeReport, printStatsReport, statsJSONFile, timeTraceFile);
+
+  // Make the module, which holds all the code.
+  if(!Streaming)
+  {
+    TheModule = std::make_unique<Module>("mini-c", TheContext);
+    if(OptLevel > 0)
+      InitializeFunctionPassManager();
+  }
+
+  //with -j or --incremental, all the code is generated before the AST is printed
+  bool codegenFirst = !Streaming && (jobs > 1 || FunctionCacheDir != "");
+  if(codegenFirst)
+  {
+    CompilePhase phase(PHASE_CODEGEN, "", false); //includes the verification and optimisation done by the workers
+    if(!parallelCodegen(jobs, timeTraceGranularity))
+    {
+      errs()<<"IR code generation failed.\n";
+      return 1;
+    }
+    if(FunctionCacheDir != "")
+      errs() << "Function cache: reused " << Stats.FunctionCacheHits << " of "
+             << Stats.FunctionCacheHits + Stats.FunctionCacheMisses << " functions\n";
+  }
 
-  //Printing out AST
+  //Printing out AST - already done with --stream
+  if(!Streaming && PrintAST)
+  {
   llvm::outs() << "\nPrinting out AST:"<< "\n\n";
   llvm::outs() << "root"<< "\n|\n";
-  for(int i = 0; i < root.size(); i++)
+  }
+  for(int i = 0; i < root.size() && !Streaming; i++)
   {
     ///IR Code Generator - this operates while traversing AST nodes
-    if(root[i]->codegen() == nullptr)
+    if(!codegenFirst)
     {
-      errs()<<"IR code generation failed.\n";
-      return 1; 
+      CompilePhase phase(PHASE_CODEGEN, "", false); //functions add their own spans to the trace
+      if(root[i]->codegen() == nullptr)
+      {
+        errs()<<"IR code generation failed.\n";
+        return 1; 
+      }
     }
 
+    if(!PrintAST)
+      continue;
+    CompilePhase phase(PHASE_PRINT_AST);
     if(i == root.size() - 1)
     {
       llvm::outs() << "|-> " << root[i] << "\n";
@@ -4452,10 +6649,32 @@ int main(int argc, char **argv) {
     }
   }
 
-  llvm::outs() << "\nAST successfully printed."<< "\n\n";
+  if(TheFPM)
+  {
+    CompilePhase phase(PHASE_OPT);
+    TheFPM->doFinalization();
+  }
+
+  if(PrintAST)
+    llvm::outs() << "\nAST successfully printed."<< "\n\n";
   llvm::outs() << "IR code generation successful."<< "\n";
 
+  if(emitObject)
+  {
+    CompilePhase phase(PHASE_BACKEND);
+    if(!writeObjects(jobs))
+      return 1;
+  }
+  else if(Streaming)
+  {
+    CompilePhase phase(PHASE_OUTPUT);
+    finishStreamOutput();
+    streamFile.reset();
+  }
+  else
   //********************* Start printing final IR **************************
+  {
+  CompilePhase phase(PHASE_OUTPUT);
   // Print out all of the generated code into a file called output.ll
   auto Filename = "output.ll";
   std::error_code EC;
@@ -4468,8 +6687,229 @@ int main(int argc, char **argv) {
 
   // TheModule->print(errs(), nullptr); // print IR to terminal
   TheModule->print(dest, nullptr);
+  }
   //********************* End printing final IR ****************************
 
-  fclose(pFile); // close the file that contains the code that was parsed
-  return 0;
-}
\ No newline at end of file
+  if(cacheKey != "")
+  {
+    CompilePhase phase(PHASE_CACHE);
+    storeInCache(cacheDir, cacheKey, ReportedWarnings, getOutputFiles(emitObject, jobs), cacheMaxSize);
+  }
+
+  return finishCompile(timeReport, printStatsReport, statsJSONFile, timeTraceFile);
+}
+
+//===----------------------------------------------------------------------===//
+// Compile server - for --server
+// Most of the time of a small compile goes to starting the process: loading and relocating LLVM, running its static
+// initialisers and initialising the native target. The server does all of that once, then listens on a Unix domain
+// socket; mccomp-client forwards its command line to it. Every request is compiled in a child forked from the
+// server, which starts from the server's initialised state, and whose globals are thrown away with it, so requests
+// are isolated from each other and several can run at once.
+//
+// Protocol: the client sends a 4-byte payload size, with its stdout, stderr and working directory attached as
+// SCM_RIGHTS file descriptors, then the payload: its arguments, each terminated by '\0'. The compile runs in the
+// client's directory, writing to the client's stdout and stderr, and the server replies with the 4-byte exit code.
+// A client that gets no reply reports the compile as crashed.
+//
+// A request can read and write anything its client can, so only the user running the server may use it: the socket is
+// created with mode 0600 (by default in a directory only that user can access), and both ends check the other's uid
+// with SO_PEERCRED before anything is sent.
+//===----------------------------------------------------------------------===//
+
+//the directory of the default socket when $XDG_RUNTIME_DIR is not set; created by the server with mode 0700
+static string getPrivateSocketDir() {
+  return "/tmp/mccomp-" + std::to_string(getuid());
+}
+
+//$MCCOMP_SOCKET, or mccomp.sock in $XDG_RUNTIME_DIR or in getPrivateSocketDir() - mccomp-client uses the same default
+static string getDefaultServerSocket() {
+  if(const char *socket = getenv("MCCOMP_SOCKET"))
+    return socket;
+  const char *runtimeDir = getenv("XDG_RUNTIME_DIR");
+  if(runtimeDir && *runtimeDir)
+    return string(runtimeDir) + "/mccomp.sock";
+  return getPrivateSocketDir() + "/mccomp.sock";
+}
+
+//creates the directory if it does not exist, and makes sure that it is a real directory only this user can access,
+//so that nobody else can replace the socket in it
+static bool makePrivateDir(const string &dir) {
+  if(mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST)
+  {
+    perror(dir.c_str());
+    return false;
+  }
+  struct stat info;
+  if(lstat(dir.c_str(), &info) != 0 || !S_ISDIR(info.st_mode) || info.st_uid != getuid() || (info.st_mode & 077) != 0)
+  {
+    errs() << dir << " is not a directory private to this user\n";
+    return false;
+  }
+  return true;
+}
+
+//the uid of the process at the other end of a Unix domain socket
+static bool getPeerUid(int conn, uid_t &uid) {
+  ucred cred;
+  socklen_t length = sizeof(cred);
+  if(getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &length) != 0)
+    return false;
+  uid = cred.uid;
+  return true;
+}
+
+static char ServerSocketPath[sizeof(sockaddr_un::sun_path)]; //for the signal handler, which can only use fixed buffers
+
+static void stopServer(int) {
+  unlink(ServerSocketPath);
+  _exit(0);
+}
+
+static bool readAll(int FD, void *buffer, size_t size) {
+  for(char *data = (char*)buffer; size != 0;)
+  {
+    ssize_t n = read(FD, data, size);
+    if(n < 0 && errno == EINTR)
+      continue;
+    if(n <= 0)
+      return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+static int compileOnLargeStack(int argc, char **argv) {
+  int status;
+  llvm::thread compiler(CompilerStackSize, [&] {
+    status = compile(argc, argv);
+  });
+  compiler.join();
+  return status;
+}
+
+//runs in the child forked for a connection; returns the exit code of the compile
+static int handleRequest(int conn) {
+  uint32_t size;
+  int fds[3]; //stdout, stderr, working directory
+  iovec iov = {&size, sizeof(size)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))];
+  msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  if(recvmsg(conn, &msg, MSG_WAITALL) != sizeof(size))
+    return 1;
+  cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if(cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))
+    return 1;
+  memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+  string payload(size, '\0');
+  if(!readAll(conn, &payload[0], size) || (size != 0 && payload.back() != '\0'))
+    return 1;
+  vector<char*> args = {(char*)"mccomp"};
+  for(size_t i = 0; i < payload.size(); i += strlen(&payload[i]) + 1)
+    args.push_back(&payload[i]);
+  args.push_back(nullptr);
+
+  if(fchdir(fds[2]) != 0 || dup2(fds[0], STDOUT_FILENO) < 0 || dup2(fds[1], STDERR_FILENO) < 0)
+    return 1;
+  for(int FD : fds)
+    close(FD);
+
+  int32_t status = compileOnLargeStack(args.size() - 1, args.data());
+  std::cout.flush();
+  fflush(nullptr);
+  outs().flush();
+  errs().flush();
+  if(write(conn, &status, sizeof(status)) != sizeof(status))
+    return 1;
+  return status;
+}
+
+static int serve(const string &socketPath) {
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if(socketPath.size() >= sizeof(addr.sun_path))
+  {
+    errs() << "Socket path too long: " << socketPath << "\n";
+    return 1;
+  }
+  strcpy(addr.sun_path, socketPath.c_str());
+  if(socketPath.rfind(getPrivateSocketDir() + "/", 0) == 0 && !makePrivateDir(getPrivateSocketDir()))
+    return 1;
+
+  int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if(listener < 0)
+  {
+    perror("socket");
+    return 1;
+  }
+  if(connect(listener, (sockaddr*)&addr, sizeof(addr)) == 0)
+  {
+    errs() << "A server is already listening on " << socketPath << "\n";
+    return 1;
+  }
+  unlink(socketPath.c_str()); //left behind by a server that did not exit cleanly
+  mode_t oldMask = umask(0177); //the socket is never accessible to other users, not even between bind() and chmod()
+  bool bound = bind(listener, (sockaddr*)&addr, sizeof(addr)) == 0;
+  umask(oldMask);
+  if(!bound || chmod(socketPath.c_str(), 0600) != 0 || listen(listener, SOMAXCONN) != 0)
+  {
+    perror(socketPath.c_str());
+    return 1;
+  }
+  strcpy(ServerSocketPath, socketPath.c_str());
+  signal(SIGINT, stopServer);
+  signal(SIGTERM, stopServer);
+  signal(SIGCHLD, SIG_IGN); //children are reaped automatically
+
+  //done once here instead of by every compile with --emit=obj or a cache
+  InitializeNativeTarget();
+  InitializeNativeTargetAsmPrinter();
+  getCompilerVersion();
+  errs() << "Listening on " << socketPath << "\n";
+
+  for(;;)
+  {
+    int conn = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    if(conn < 0)
+    {
+      if(errno == EINTR || errno == ECONNABORTED)
+        continue;
+      perror("accept");
+      return 1;
+    }
+    uid_t peer;
+    if(!getPeerUid(conn, peer) || peer != getuid())
+    {
+      errs() << "Refused a connection from another user\n";
+      close(conn);
+      continue;
+    }
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+      signal(SIGINT, SIG_DFL);
+      signal(SIGTERM, SIG_DFL);
+      signal(SIGCHLD, SIG_DFL);
+      close(listener);
+      _exit(handleRequest(conn));
+    }
+    if(pid < 0)
+      perror("fork");
+    close(conn);
+  }
+}
+
+int main(int argc, char **argv) {
+  MainArgv0 = argv[0];
+  if(argc == 2 && string(argv[1]) == "--server")
+    return serve(getDefaultServerSocket());
+  if(argc == 2 && string(argv[1]).rfind("--server=", 0) == 0)
+    return serve(argv[1] + 9);
+  return compileOnLargeStack(argc, argv);
+}
@@ -0,0 +1,23 @@
+// MiniC program to test function calls used as operands, and unary operators applied to parenthesised operands
+int add(int a, int b) {
+  return a + b;
+}
+
+int sub(int a, int b) {
+  return a - b;
+}
+
+int calls(int a) {
+  int r;
+  bool t;
+  t = false;
+  // a call followed by an operator, and calls as arguments of a call
+  r = add(a, 2) * 3;
+  r = r + sub(add(a, a), add(1, 1));
+  // the unary operators apply to the parenthesised operand only
+  r = -(a) + r;
+  if (!(t) && a > 3) {
+    r = r + 1;
+  }
+  return add(r, -(a)) - sub(a, 1) * 2;
+}
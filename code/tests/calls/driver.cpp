@@ -0,0 +1,32 @@
+#include <iostream>
+#include <cstdio>
+
+// clang++ driver.cpp output.ll -o calls
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+extern "C" DLLEXPORT int print_int(int X) {
+  fprintf(stderr, "%d\n", X);
+  return 0;
+}
+
+extern "C" DLLEXPORT float print_float(float X) {
+  fprintf(stderr, "%f\n", X);
+  return 0;
+}
+
+extern "C" {
+    int calls(int a);
+}
+
+int main() {
+    int f = calls(4);
+    if(f == 11)
+      std::cout << "PASSED Result: " << f << std::endl;
+  	else
+  	  std::cout << "FALIED Result: " << f << std::endl;
+}
@@ -0,0 +1,41 @@
+// MiniC program to test constant folding and algebraic simplification
+extern int print_int(int X);
+extern float print_float(float X);
+
+int constfold(int n) {
+    int a;
+    bool c;
+    int result;
+
+    a = 2 * 3 + 4 * (5 - 1);
+    print_int(a);
+    c = !!(n > 0);
+    a = a + n * 1 + 0;
+    print_int(a);
+    result = a + (true + 1) - --n / 1;
+    print_int(result);
+    if (c && true) {
+        result = result + 1;
+    }
+    if (false || 10 > 3 * 3) {
+        result = result * 1 + 0 * n;
+    }
+    if (false && c) {
+        result = 0;
+    }
+    return result;
+}
+
+float constfold_float(float f) {
+    float b;
+    b = 1.5 * 2 + 1;
+    b = b + f / 1.0 - 0.0 + -(2 - 3);
+    print_float(b);
+    return b * 1 + (7 % 4);
+}
+
+int constfold_wrap(void) {
+    int x;
+    x = 2147483647 + 1;
+    return x / 2;
+}
@@ -0,0 +1,36 @@
+#include <iostream>
+#include <cstdio>
+
+// clang++ driver.cpp output.ll -o constfold
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+extern "C" DLLEXPORT int print_int(int X) {
+  fprintf(stderr, "%d\n", X);
+  return 0;
+}
+
+extern "C" DLLEXPORT float print_float(float X) {
+  fprintf(stderr, "%f\n", X);
+  return 0;
+}
+
+extern "C" {
+    int constfold(int n);
+    float constfold_float(float f);
+    int constfold_wrap(void);
+}
+
+int main() {
+    int i = constfold(5);
+    float f = constfold_float(2.5);
+    int w = constfold_wrap();
+    if(i == 25 && f == 10.5 && w == -1073741824)
+      std::cout << "PASSED Result: " << i << " " << f << " " << w << std::endl;
+  	else
+  	  std::cout << "FALIED Result: " << i << " " << f << " " << w << std::endl;
+}
@@ -0,0 +1,32 @@
+#include <iostream>
+#include <cstdio>
+
+// clang++ driver.cpp output.ll -o jobs
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+extern "C" DLLEXPORT int print_int(int X) {
+  fprintf(stderr, "%d\n", X);
+  return 0;
+}
+
+extern "C" DLLEXPORT float print_float(float X) {
+  fprintf(stderr, "%f\n", X);
+  return 0;
+}
+
+extern "C" {
+    int jobs(int x);
+}
+
+int main() {
+    int f = jobs(3);
+    if(f == 21)
+      std::cout << "PASSED Result: " << f << std::endl;
+  	else
+  	  std::cout << "FALIED Result: " << f << std::endl;
+}
@@ -0,0 +1,38 @@
+// MiniC program to test that -j N gives the same output.ll as -j 1, with globals used by different functions
+extern int print_int(int X);
+int a;
+float b;
+bool c;
+int d;
+
+int setd(int x) {
+  d = x * 2;
+  return d;
+}
+
+bool setc(bool x) {
+  c = !x;
+  return c;
+}
+
+float setb(float x) {
+  b = x + 0.5;
+  return b;
+}
+
+int seta(int x) {
+  a = x + 1;
+  return a;
+}
+
+int jobs(int x) {
+  int r;
+  r = seta(x) + setd(x);
+  if (setc(false)) {
+    r = r + 1;
+  }
+  if (setb(1.0) > 1.0) {
+    r = r + a + d;
+  }
+  return r;
+}
@@ -0,0 +1,32 @@
+// MiniC program to test --lazy-bodies: only the bodies reachable from lazybodies() are parsed and generated
+int calls;
+
+int square(int a) {
+  return a * a;
+}
+
+// never called: the syntax error in its body is not seen with --lazy-bodies
+int broken(int a) {
+  return a +* 3
+}
+
+// never called: its undeclared variable is not seen either
+int unused(int a) {
+  return square(b);
+}
+
+int sum(int n) {
+  int r;
+  r = 0;
+  while (n > 0) {
+    r = r + square(n);
+    calls = calls + 1;
+    n = n - 1;
+  }
+  return r;
+}
+
+int lazybodies(int n) {
+  calls = 0;
+  return sum(n) + calls;
+}
@@ -12,6 +12,7 @@
 extern "C" {
     int lazyeval_and(int control);
     int lazyeval_or(int control);
+    int lazyeval_cheap(int a, int b, bool c);
 }
 
 int main() {
@@ -41,4 +42,10 @@ int main() {
       std::cout << "PASSED lazy_or when LHS is false Result: " << or_false << std::endl;
   	else
   	  std::cout << "FALIED lazy_or when LHS is false Result: " << or_false << std::endl;
+
+    int cheap = lazyeval_cheap(1, 1, false) + lazyeval_cheap(1, -1, false) + lazyeval_cheap(-1, 1, true) + lazyeval_cheap(0, 0, false);
+    if(cheap == 2)
+      std::cout << "PASSED lazy_cheap Result: " << cheap << std::endl;
+  	else
+  	  std::cout << "FALIED lazy_cheap Result: " << cheap << std::endl;
 }
\ No newline at end of file
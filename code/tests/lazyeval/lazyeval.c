@@ -1,15 +1,15 @@
 int mutable_var;
 
-int mutating_function(void) {
+bool mutating_function(void) {
     mutable_var = mutable_var + 1;
-    return 1;
+    return true;
 }
 
 // If control == 1 then mutating_function should be run and mutable_var = 1
 // If control != 1 then mutating_function should not be run and mutable_var = 0
 int lazyeval_and(int control) {
     mutable_var = 0;
-    if (false && mutating_function()) {
+    if (control == 1 && mutating_function()) {
         return mutable_var;
     } else {
         return mutable_var;
@@ -20,9 +20,17 @@ int lazyeval_and(int control) {
 // If control != 1 then mutating_function should be run and mutable_var = 1
 int lazyeval_or(int control) {
     mutable_var = 0;
-    if (true || mutating_function()) {
+    if (control == 1 || mutating_function()) {
         return mutable_var;
     } else {
         return mutable_var;
     }
-}
\ No newline at end of file
+}
+
+// Cheap right hand sides without side effects - returns 1 only if both a and b are positive, or c is true
+int lazyeval_cheap(int a, int b, bool c) {
+    if (a > 0 && b > 0 || c) {
+        return 1;
+    }
+    return 0;
+}
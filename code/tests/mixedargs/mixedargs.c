@@ -0,0 +1,21 @@
+// MiniC program to test implicit conversions of each argument of a function call
+extern int print_int(int X);
+
+float weighted(float w, int n, float x, bool b) {
+  float result;
+  result = w * n + x;
+  if (b) {
+    result = result + 1;
+  }
+  return result;
+}
+
+float mixedargs(int a) {
+  bool t;
+  float first;
+  t = true;
+  // int to float, bool to int, int to float and bool as it is
+  first = weighted(a, t, 2, t);
+  // float as it is, int as it is, bool to float and bool as it is
+  return first + weighted(0.5, a, t, false);
+}
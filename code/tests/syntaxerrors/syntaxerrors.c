@@ -0,0 +1,33 @@
+extern int print_int(int x);
+extern int oops(int x
+
+int g;
+
+int f(int a) {
+  int b;
+  int ;
+  b = a + ;
+  if (a > 1 {
+    b = 2;
+  } else {
+    b = 3;
+  }
+  while (a > 0) {
+    a = a - 1
+    b = b * 2;
+  }
+  return b;
+}
+
+int h(int a b) {
+  return a;
+}
+
+void k() {
+  print_int(1));
+  return;
+}
+
+int main() {
+  return f(1);
+}
@@ -23,7 +23,7 @@ rm -rf ./mccomp
 echo "Compile *****"
 
 make clean
-make -j mccomp
+make -j mccomp mccomp-client
 
 COMP=$DIR/mccomp
 echo $COMP
@@ -56,11 +56,26 @@ associativity=1
 global=1
 implicit=1
 # infinte=1 #infinite test - run manually
-# lazyeval=1 #fails for expr - only works for constants - mention in report
+lazyeval=1
 returns=1
 # scope=1 #fails - not implemented - mention in report
 # unary2=1 #cannot do - narrowing conversions denied
 while2=1
+constfold=1
+mixedargs=1
+emitobj=1 #lazyeval compiled to two objects with --emit=obj -j 2
+server=1 #addition compiled through mccomp --server and mccomp-client
+check=1 #-fsyntax-only and --check accept addition without writing output.ll
+stream=1 #recurse compiled with --stream
+calls=1 #calls used as operands and unary operators on parenthesised operands
+lazybodies=1 #only the functions reachable from lazybodies are parsed and generated with --lazy-bodies
+parallelparse=1 #calls compiled with -fparallel-parse -j 2, and the syntax errors reported in source order
+syntaxerrors=1 #every syntax error is reported in one run, up to -ferror-limit
+astcache=1 #calls compiled with --ast-cache twice, the second time from calls.c.astcache
+jobs=1 #jobs compiled with -j 1 and -j 4, which must give the same output.ll
+cache=1 #constfold compiled twice with --cache-dir, the second time with -j 4 and restored from the cache with its warning
+incremental=1 #calls compiled with --incremental, then again with one of its three functions edited
+nesting=1 #100,000 nested ifs, elses and whiles parsed with -fsyntax-only
 
 cd tests/addition/
 
@@ -217,15 +232,15 @@ then
 	validate "./implicit"
 fi
 
-# if [ $lazyeval == 1 ];
-# then	
-# 	cd ../lazyeval
-# 	pwd
-# 	rm -rf output.ll lazyeval
-# 	"$COMP" ./lazyeval.c
-# 	$CLANG driver.cpp output.ll -o lazyeval
-# 	validate "./lazyeval"
-# fi
+if [ $lazyeval == 1 ];
+then	
+	cd ../lazyeval
+	pwd
+	rm -rf output.ll lazyeval
+	"$COMP" ./lazyeval.c
+	$CLANG driver.cpp output.ll -o lazyeval
+	validate "./lazyeval"
+fi
 
 if [ $returns == 1 ];
 then	
@@ -267,4 +282,186 @@ then
 	validate "./while2"
 fi
 
+if [ $constfold == 1 ];
+then	
+	cd ../constfold
+	pwd
+	rm -rf output.ll constfold
+	"$COMP" ./constfold.c
+	$CLANG driver.cpp output.ll -o constfold
+	validate "./constfold"
+fi
+
+if [ $mixedargs == 1 ];
+then	
+	cd ../mixedargs
+	pwd
+	rm -rf output.ll mixedargs
+	"$COMP" ./mixedargs.c
+	$CLANG driver.cpp output.ll -o mixedargs
+	validate "./mixedargs"
+fi
+
+if [ $emitobj == 1 ];
+then	
+	cd ../lazyeval
+	pwd
+	rm -rf output.0.o output.1.o lazyeval_obj
+	"$COMP" --emit=obj -j 2 ./lazyeval.c
+	$CLANG driver.cpp output.0.o output.1.o -o lazyeval_obj
+	validate "./lazyeval_obj"
+fi
+
+if [ $server == 1 ];
+then	
+	cd ../addition
+	pwd
+	rm -rf output.ll addition_server
+	SOCKET="$DIR/mccomp-test.sock"
+	"$COMP" --server="$SOCKET" &
+	SERVER=$!
+	while [ ! -S "$SOCKET" ]; do sleep 0.1; done
+	"$DIR/mccomp-client" --socket="$SOCKET" ./addition.c
+	kill $SERVER
+	$CLANG driver.cpp output.ll -o addition_server
+	validate "./addition_server"
+fi
+
+if [ $check == 1 ];
+then	
+	cd ../addition
+	pwd
+	rm -rf output.ll
+	"$COMP" -fsyntax-only ./addition.c
+	"$COMP" --check ./addition.c
+	if [ -f output.ll ]; then echo "TEST FAILED ***** output.ll written by --check"; exit 1; fi
+fi
+
+if [ $stream == 1 ];
+then	
+	cd ../recurse
+	pwd
+	rm -rf output.ll recurse_stream
+	"$COMP" --stream ./recurse.c
+	$CLANG driver.cpp output.ll -o recurse_stream
+	validate "./recurse_stream"
+fi
+
+if [ $calls == 1 ];
+then	
+	cd ../calls
+	pwd
+	rm -rf output.ll calls
+	"$COMP" ./calls.c
+	$CLANG driver.cpp output.ll -o calls
+	validate "./calls"
+fi
+
+if [ $lazybodies == 1 ];
+then	
+	cd ../lazybodies
+	pwd
+	rm -rf output.ll lazybodies
+	"$COMP" --lazy-bodies=lazybodies ./lazybodies.c
+	if grep -q "broken\|unused" output.ll; then echo "TEST FAILED ***** unreachable functions generated"; exit 1; fi
+	$CLANG driver.cpp output.ll -o lazybodies
+	validate "./lazybodies"
+fi
+
+if [ $syntaxerrors == 1 ];
+then	
+	cd ../syntaxerrors
+	pwd
+	if "$COMP" -fsyntax-only ./syntaxerrors.c 2> errors_out; then echo "TEST FAILED ***** syntax errors accepted"; exit 1; fi
+	if [ $(grep -c "Syntax error" errors_out) != 7 ]; then echo "TEST FAILED ***** expected 7 syntax errors"; cat errors_out; exit 1; fi
+	if "$COMP" -fsyntax-only -ferror-limit=3 ./syntaxerrors.c 2> errors_out; then echo "TEST FAILED ***** syntax errors accepted"; exit 1; fi
+	if [ $(grep -c "Syntax error" errors_out) != 3 ]; then echo "TEST FAILED ***** expected 3 syntax errors with -ferror-limit=3"; cat errors_out; exit 1; fi
+	rm errors_out
+fi
+
+if [ $parallelparse == 1 ];
+then	
+	cd ../calls
+	pwd
+	rm -rf output.ll calls_parallel
+	"$COMP" -fparallel-parse -j 2 ./calls.c
+	$CLANG driver.cpp output.ll -o calls_parallel
+	validate "./calls_parallel"
+	cd ../syntaxerrors
+	"$COMP" -fsyntax-only ./syntaxerrors.c 2> serial_errors || true
+	"$COMP" -fsyntax-only -fparallel-parse -j 3 ./syntaxerrors.c 2> errors_out || true
+	if ! cmp -s serial_errors errors_out; then echo "TEST FAILED ***** -fparallel-parse reported different errors"; exit 1; fi
+	rm serial_errors errors_out
+fi
+
+if [ $astcache == 1 ];
+then	
+	cd ../calls
+	pwd
+	rm -rf output.ll calls.c.astcache calls_astcache
+	"$COMP" --ast-cache ./calls.c
+	cp output.ll parsed.ll
+	"$COMP" --ast-cache ./calls.c 2> astcache_out
+	if ! grep -q "AST cache hit" astcache_out; then echo "TEST FAILED ***** --ast-cache did not load calls.c.astcache"; exit 1; fi
+	if ! cmp -s parsed.ll output.ll; then echo "TEST FAILED ***** the AST loaded with --ast-cache generated different code"; exit 1; fi
+	$CLANG driver.cpp output.ll -o calls_astcache
+	validate "./calls_astcache"
+	rm parsed.ll astcache_out calls.c.astcache
+fi
+
+if [ $jobs == 1 ];
+then	
+	cd ../jobs
+	pwd
+	rm -rf output.ll output_j1.ll jobs
+	"$COMP" -j 1 ./jobs.c
+	mv output.ll output_j1.ll
+	"$COMP" -j 4 ./jobs.c
+	if ! cmp -s output_j1.ll output.ll; then echo "TEST FAILED ***** -j 4 generated a different output.ll"; exit 1; fi
+	rm output_j1.ll
+	$CLANG driver.cpp output.ll -o jobs
+	validate "./jobs"
+fi
+
+if [ $cache == 1 ];
+then	
+	cd ../constfold
+	pwd
+	rm -rf output.ll generated.ll cache_out cache_stats.json mccomp_cache constfold_cache
+	"$COMP" --cache-dir=mccomp_cache ./constfold.c 2> cache_out
+	if grep -q "Cache hit" cache_out; then echo "TEST FAILED ***** --cache-dir hit in an empty cache"; exit 1; fi
+	cp output.ll generated.ll
+	"$COMP" --cache-dir=mccomp_cache -j 4 --stats-json=cache_stats.json ./constfold.c 2> cache_out
+	if ! grep -q "Cache hit" cache_out; then echo "TEST FAILED ***** --cache-dir missed the entry of the first compile"; exit 1; fi
+	if ! grep -q "Warning: Constant expression out of range" cache_out; then echo "TEST FAILED ***** --cache-dir hit did not print the warning of the first compile"; exit 1; fi
+	if [ ! -f cache_stats.json ]; then echo "TEST FAILED ***** --cache-dir hit did not write --stats-json"; exit 1; fi
+	if ! cmp -s generated.ll output.ll; then echo "TEST FAILED ***** --cache-dir restored a different output.ll"; exit 1; fi
+	$CLANG driver.cpp output.ll -o constfold_cache
+	validate "./constfold_cache"
+	rm -rf generated.ll cache_out cache_stats.json mccomp_cache
+fi
+
+if [ $incremental == 1 ];
+then	
+	cd ../calls
+	pwd
+	rm -rf output.ll cache_out mccomp_cache calls_edited.c calls_incremental
+	"$COMP" --cache-dir=mccomp_cache --incremental ./calls.c
+	sed 's/return a - b;/return a - b + 0;/' calls.c > calls_edited.c
+	"$COMP" --cache-dir=mccomp_cache --incremental ./calls_edited.c 2> cache_out
+	if ! grep -q "reused 2 of 3 functions" cache_out; then echo "TEST FAILED ***** --incremental did not reuse the two unchanged functions"; exit 1; fi
+	$CLANG driver.cpp output.ll -o calls_incremental
+	validate "./calls_incremental"
+	rm -rf cache_out mccomp_cache calls_edited.c
+fi
+
+if [ $nesting == 1 ];
+then	
+	cd ../syntaxerrors
+	pwd
+	{ echo "int nested(int a) {"; yes "if (a > 0) { while (a > 1) a = a - 1;" | head -n 100000; yes "} else { a = 0; }" | head -n 100000; echo "return a; }"; } > nested.c
+	if ! "$COMP" -fsyntax-only ./nested.c; then echo "TEST FAILED ***** 100,000 nested statements were not accepted"; exit 1; fi
+	rm nested.c
+fi
+
 echo "***** ALL TESTS PASSED *****"
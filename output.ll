@@ -0,0 +1,77 @@
+; ModuleID = 'mini-c'
+source_filename = "mini-c"
+
+declare i32 @print_int(i32)
+
+declare float @print_float(float)
+
+define i32 @constfold(i32 %n) {
+entry:
+  %result = alloca i32, align 4
+  %c = alloca i1, align 1
+  %a = alloca i32, align 4
+  %n1 = alloca i32, align 4
+  store i32 %n, i32* %n1, align 4
+  store i32 22, i32* %a, align 4
+  %call_tmp = call i32 @print_int(i32 22)
+  %gt_tmp = icmp sgt i32 %n, 0
+  store i1 %gt_tmp, i1* %c, align 1
+  %add_tmp = add i32 22, %n
+  store i32 %add_tmp, i32* %a, align 4
+  %call_tmp2 = call i32 @print_int(i32 %add_tmp)
+  %add_tmp3 = add i32 %add_tmp, 2
+  %sub_tmp = sub i32 %add_tmp3, %n
+  store i32 %sub_tmp, i32* %result, align 4
+  %call_tmp4 = call i32 @print_int(i32 %sub_tmp)
+  %if_cond = icmp ne i1 %gt_tmp, false
+  br i1 %if_cond, label %if_then, label %if_end
+
+if_then:                                          ; preds = %entry
+  %load_temp = load i32, i32* %result, align 4
+  %add_tmp5 = add i32 %load_temp, 1
+  store i32 %add_tmp5, i32* %result, align 4
+  br label %if_end
+
+if_end:                                           ; preds = %if_then, %entry
+  br i1 true, label %if_then6, label %if_end10
+
+if_then6:                                         ; preds = %if_end
+  %load_temp7 = load i32, i32* %result, align 4
+  %load_temp8 = load i32, i32* %n1, align 4
+  %mul_tmp = mul i32 0, %load_temp8
+  %add_tmp9 = add i32 %load_temp7, %mul_tmp
+  store i32 %add_tmp9, i32* %result, align 4
+  br label %if_end10
+
+if_end10:                                         ; preds = %if_then6, %if_end
+  br i1 false, label %if_then11, label %if_end12
+
+if_then11:                                        ; preds = %if_end10
+  store i32 0, i32* %result, align 4
+  br label %if_end12
+
+if_end12:                                         ; preds = %if_then11, %if_end10
+  %load_temp13 = load i32, i32* %result, align 4
+  ret i32 %load_temp13
+}
+
+define float @constfold_float(float %f) {
+entry:
+  %b = alloca float, align 4
+  %f1 = alloca float, align 4
+  store float %f, float* %f1, align 4
+  store float 4.000000e+00, float* %b, align 4
+  %fadd_tmp = fadd float 4.000000e+00, %f
+  %fadd_tmp2 = fadd float %fadd_tmp, 1.000000e+00
+  store float %fadd_tmp2, float* %b, align 4
+  %call_tmp = call float @print_float(float %fadd_tmp2)
+  %fadd_tmp3 = fadd float %fadd_tmp2, 3.000000e+00
+  ret float %fadd_tmp3
+}
+
+define i32 @constfold_wrap() {
+entry:
+  %x = alloca i32, align 4
+  store i32 -2147483648, i32* %x, align 4
+  ret i32 -1073741824
+}